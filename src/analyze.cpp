@@ -25,17 +25,19 @@ SolutionAnalysis::SolutionAnalysis(
     board_letters(b.get_letters()) {
 
     /* Expects a SolutionList sorted by word then by point value descending */
-    std::string last_word = "";
+    uint32_t last_word_id = Dictionary::NO_WORD;
+    std::string word;
     std::set<int> last_word_positions;
     
     for(auto const &i : solutions) {
         size_t score = i.get_score();
-        const std::string &word = i.get_word();
-        size_t word_length = word.size();
+        bool new_word = i.get_word_id() != last_word_id;
 
-        if (word != last_word) {
+        if (new_word) {
+            word = i.get_word();
             last_word_positions.clear();
         }
+        size_t word_length = word.size();
 
         /* Update best scoring n-letter word */
         if (best_word_points[word_length] < score) {
@@ -49,7 +51,7 @@ SolutionAnalysis::SolutionAnalysis(
             best_word_points[0] = score;
         }
 
-        if (word != last_word) {
+        if (new_word) {
             // Update the number of words of this length found
             word_length_counts[word_length]++;
             word_length_counts[0]++;
@@ -73,10 +75,10 @@ SolutionAnalysis::SolutionAnalysis(
             position_points[0] += score;
         }
 
-        for (const unsigned char *pos = i.positions_begin();
+        for (const TilePosition *pos = i.positions_begin();
                 pos != i.positions_end(); ++pos) {
 
-            unsigned char p = *pos + 1; // 0-based to 1-based
+            size_t p = *pos + 1; // 0-based to 1-based
 
             if (last_word_positions.find(p) != last_word_positions.end()) {
                 // Continue if we have already accounted for one instance of
@@ -92,7 +94,7 @@ SolutionAnalysis::SolutionAnalysis(
             last_word_positions.insert(p);
         }
 
-        last_word = word;
+        last_word_id = i.get_word_id();
     }
 }
 
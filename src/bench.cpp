@@ -0,0 +1,271 @@
+// This file is part of WGS, a customizable Word Game Solver.
+//
+// Copyright 2014 Robert Gamble <rgamble99@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "analyze.h"
+#include "bench.h"
+#include "dictionary.h"
+#include "maker.h"
+#include "random.h"
+#include "scramble.h"
+#include "thread_pool.h"
+#include "validate.h"
+#include "wgs.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const int LOAD_RUNS = 5;         // times each dictionary is loaded
+static const int BLANKS = 2;            // wildcards in the solve-blanks boards
+static const size_t BOARDS_PER_CREATE = 20;
+static const size_t TEMPERING_REPLICAS = 4;
+
+static double seconds_since(Clock::time_point start) {
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return elapsed.count();
+}
+
+static double percentile(const std::vector<double> &sorted, double p) {
+    // Nearest rank percentile of a sorted, non-empty list
+    size_t rank = std::ceil(p / 100 * sorted.size());
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void report(const std::string &game, const std::string &benchmark,
+    std::vector<double> &samples, size_t items) {
+    // One line per benchmark, the percentiles are of the time taken by
+    // each sample in microseconds
+    if (samples.empty()) return;
+
+    std::sort(samples.begin(), samples.end());
+    double seconds = 0;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        seconds += samples[i];
+    }
+
+    std::cout << game << "\t" << benchmark << "\t" << samples.size() << "\t"
+        << items << "\t" << seconds << "\t"
+        << (seconds > 0 ? items / seconds : 0) << "\t"
+        << percentile(samples, 50) * 1e6 << "\t"
+        << percentile(samples, 90) * 1e6 << "\t"
+        << percentile(samples, 99) * 1e6 << "\t"
+        << samples.back() * 1e6 << std::endl;
+}
+
+static std::string add_blanks(const std::string &letters, int blanks, Random &rng) {
+    // Replace up to blanks randomly chosen tiles with a wildcard, keeping
+    // any multiplier prefixes
+    std::vector<size_t> starts;
+    for (size_t i = 0; i < letters.size(); ++i) {
+        if (std::isupper(letters[i]) || letters[i] == '?' || letters[i] == '.') {
+            starts.push_back(i);
+        }
+    }
+
+    rng.shuffle(starts);
+    if (starts.size() > (size_t) blanks) {
+        starts.resize(blanks);
+    }
+
+    std::string result;
+    for (size_t i = 0; i < letters.size(); ++i) {
+        if (std::find(starts.begin(), starts.end(), i) != starts.end()) {
+            result += '?';
+            while (i + 1 < letters.size() && std::islower(letters[i + 1])) {
+                ++i;
+            }
+        }
+        else {
+            result += letters[i];
+        }
+    }
+    return result;
+}
+
+static bool bench_game(GameConfig &config, const std::string &game,
+    const BenchOptions &opts, ThreadPool *search_pool) {
+    GameRuleSet grs(config, game);
+    if (!grs.grid || !grs.dict || !grs.scoring_rules || !grs.letters) {
+        std::cerr << "Game type '" << game << "' is not fully configured" << std::endl;
+        return false;
+    }
+
+    std::vector<double> samples;
+    std::unique_ptr<Dictionary> dict;
+    for (int i = 0; i < LOAD_RUNS; ++i) {
+        dict.reset(new Dictionary);
+        Clock::time_point start = Clock::now();
+        if (!dict->load(grs.dict->dictFileName(), grs.dict->structure() == "DAWG")) {
+            return false;
+        }
+        samples.push_back(seconds_since(start));
+    }
+    report(game, "load", samples, samples.size());
+
+    // Each game's corpus depends only on the seed, not on which other
+    // games are measured
+    Random rng(opts.seed);
+    std::vector<std::string> corpus;
+    for (size_t i = 0; i < opts.boards; ++i) {
+        std::string board = generate_simple_board(grs, rng);
+        if (board.empty()) {
+            std::cerr << "No boards can be generated for game type '" << game
+                << "', only loading is measured" << std::endl;
+            return true;
+        }
+        corpus.push_back(board);
+    }
+
+    Solver s(*dict);
+    s.set_thread_pool(search_pool);
+
+    // The words found are used for check-word.  Boards are solved as the
+    // solve command does, keeping the best path for each word.
+    std::set<std::string> words;
+    samples.clear();
+    for (size_t i = 0; i < corpus.size(); ++i) {
+        Clock::time_point start = Clock::now();
+        Board b(corpus[i], grs.grid);
+        s.solve(&b, *grs.scoring_rules, true);
+        samples.push_back(seconds_since(start));
+
+        const Solver::SolutionList &solutions = s.get_solutions();
+        for (auto j = solutions.begin(); j != solutions.end(); ++j) {
+            words.insert(j->get_word());
+        }
+    }
+    report(game, "solve", samples, samples.size());
+
+    rng = Random(opts.seed, 1);
+    std::vector<std::string> blank_corpus;
+    for (size_t i = 0; i < corpus.size(); ++i) {
+        blank_corpus.push_back(add_blanks(corpus[i], BLANKS, rng));
+    }
+
+    samples.clear();
+    for (size_t i = 0; i < blank_corpus.size(); ++i) {
+        Clock::time_point start = Clock::now();
+        Board b(blank_corpus[i], grs.grid);
+        s.solve(&b, *grs.scoring_rules, true);
+        samples.push_back(seconds_since(start));
+    }
+    report(game, "solve-blanks", samples, samples.size());
+
+    // The distinct words on each board set the target for create, as
+    // that is what the annealer counts
+    std::vector<size_t> word_counts;
+    samples.clear();
+    for (size_t i = 0; i < corpus.size(); ++i) {
+        Clock::time_point start = Clock::now();
+        Board b(corpus[i], grs.grid);
+        Solver::Score score = s.score(&b, *grs.scoring_rules);
+        samples.push_back(seconds_since(start));
+        word_counts.push_back(score.words);
+    }
+    report(game, "score", samples, samples.size());
+
+    std::string fmt = grs.preferences->preference("AnalysisFormat");
+    samples.clear();
+    for (size_t i = 0; i < corpus.size(); ++i) {
+        Clock::time_point start = Clock::now();
+        Board b(corpus[i], grs.grid);
+        s.solve(&b, *grs.scoring_rules);
+        Solver::SolutionList solutions = s.get_solutions();
+        sort(solutions.begin(), solutions.end());
+        SolutionAnalysis sa(b, solutions);
+        sa.format(fmt);
+        samples.push_back(seconds_since(start));
+    }
+    report(game, "analyze", samples, samples.size());
+
+    // Boards are annealed until they have as many words as the 90th
+    // percentile of the corpus, an unreachable target can keep the
+    // annealer going indefinitely.  The rate is of candidate boards scored.
+    // The same target is then made by parallel tempering.
+    if (grs.letters->generationMethod() != "WordList" && !corpus.empty()) {
+        std::sort(word_counts.begin(), word_counts.end());
+        size_t target = word_counts[(word_counts.size() - 1) * 9 / 10];
+
+        TemperingSchedule schedules[2];
+        schedules[1].replicas = TEMPERING_REPLICAS;
+        const char *names[] = { "create", "create-tempering" };
+        for (int n = 0; n < 2; ++n) {
+            rng = Random(opts.seed, 2 + n);
+            size_t iterations = 0;
+            samples.clear();
+            for (size_t i = 0; i < std::max<size_t>(corpus.size() / BOARDS_PER_CREATE, 1); ++i) {
+                size_t scored = 0;
+                Clock::time_point start = Clock::now();
+                generate_board(grs, s, rng, std::max<size_t>(target, 1), 0, false, 0, &scored, &schedules[n]);
+                samples.push_back(seconds_since(start));
+                iterations += scored;
+            }
+            report(game, names[n], samples, iterations);
+        }
+    }
+
+    Validator v;
+    samples.clear();
+    for (auto i = words.begin(); i != words.end(); ++i) {
+        Clock::time_point start = Clock::now();
+        v.validate(grs, *i, true);
+        samples.push_back(seconds_since(start));
+    }
+    report(game, "check-word", samples, samples.size());
+
+    return true;
+}
+
+int run_benchmarks(GameConfig &config, const BenchOptions &opts) {
+    std::vector<std::string> games = opts.games;
+    if (games.empty()) {
+        for (auto i = config.game_rules.begin(); i != config.game_rules.end(); ++i) {
+            games.push_back(i->first);
+        }
+    }
+
+    for (size_t i = 0; i < games.size(); ++i) {
+        if (config.game_rules.find(games[i]) == config.game_rules.end()) {
+            std::cerr << "'" << games[i] << "' is not a valid game type" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::unique_ptr<ThreadPool> search_pool;
+    if (opts.search_threads > 1) {
+        search_pool.reset(new ThreadPool(opts.search_threads));
+    }
+
+    std::cout << "game\tbenchmark\tsamples\titems\tseconds\titems/sec"
+        "\tp50 us\tp90 us\tp99 us\tmax us" << std::endl;
+
+    int result = EXIT_SUCCESS;
+    for (size_t i = 0; i < games.size(); ++i) {
+        if (!bench_game(config, games[i], opts, search_pool.get())) {
+            result = EXIT_FAILURE;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,39 @@
+// This file is part of WGS, a customizable Word Game Solver.
+//
+// Copyright 2014 Robert Gamble <rgamble99@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WGS_BENCH_H
+#define WGS_BENCH_H
+
+#include <string>
+#include <vector>
+#include "wgs.h"
+
+class BenchOptions {
+public:
+    size_t boards;                  // boards in each game's corpus
+    unsigned seed;                  // seed the corpus is generated from
+    size_t search_threads;          // threads searching each board
+    std::vector<std::string> games; // games to measure, empty for all
+
+    BenchOptions() : boards(100), seed(1), search_threads(1) {}
+};
+
+// Runs the benchmark suite, see the bench command in solver.cpp for the
+// measurements and output format.  Returns the exit status for the program.
+int run_benchmarks(GameConfig &config, const BenchOptions &opts);
+
+#endif
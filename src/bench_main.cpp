@@ -0,0 +1,51 @@
+// This file is part of WGS, a customizable Word Game Solver.
+//
+// Copyright 2014 Robert Gamble <rgamble99@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Runs the same benchmark suite as the bench command of wgs, without the
+// rest of the program.
+
+#include <cstdlib>
+#include <iostream>
+#include "bench.h"
+#include "wgs.h"
+#include "wgs_json.h"
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " config-file [boards [seed [game-type...]]]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    GameConfig config;
+    if (json_read_config(config, argv[1]) != 0) {
+        std::cerr << "Failed to read config file '" << argv[1] << "'" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    BenchOptions opts;
+    if (argc >= 3) {
+        opts.boards = std::strtoul(argv[2], 0, 10);
+    }
+    if (argc >= 4) {
+        opts.seed = std::strtoul(argv[3], 0, 10);
+    }
+    for (int i = 4; i < argc; ++i) {
+        opts.games.push_back(argv[i]);
+    }
+
+    return run_benchmarks(config, opts);
+}
@@ -19,12 +19,12 @@
 #include <string>
 #include "dice.h"
 
-Dice::Dice(const std::vector<std::vector<std::string> > _dice):
-    dice(_dice), positions(dice.size()), die_faces(dice.size()) {
+Dice::Dice(const std::vector<std::vector<std::string> > _dice, Random &_rng):
+    rng(&_rng), dice(_dice), positions(dice.size()), die_faces(dice.size()) {
     roll();
 }
 
-std::string Dice::get_letters() {
+std::string Dice::get_letters() const {
     // Get the letters that correspond to the current board
     std::string s;
     for (size_t i = 0; i < dice.size(); ++i) {
@@ -46,7 +46,7 @@ void Dice::swap_dice(int i, int j) {
 
 void Dice::roll(int i) {
     // Randomly select a face for die at position i
-    die_faces[i] = rand() % dice.at(positions[i]).size();
+    die_faces[i] = rng->below(dice.at(positions[i]).size());
 } 
 
 void Dice::roll() {
@@ -69,7 +69,7 @@ void Dice::scramble() {
     int r = 0;
 
     while (max > 0) {
-        r = rand() % max;
+        r = rng->below(max);
         swap_dice(r, max);
         --max;
     }
@@ -20,18 +20,21 @@
 
 #include <vector>
 #include <string>
-#include <cstdlib>
+#include "random.h"
 
 class Dice {
 public:
-    Dice(const std::vector<std::vector<std::string> > dice);
-    std::string get_letters();
+    // Dice are rolled with rng, which must outlive them
+    Dice(const std::vector<std::vector<std::string> > dice, Random &rng);
+    std::string get_letters() const;
+    size_t size() const { return dice.size(); }
     void swap_dice(int i, int j);
     void roll(int i);
     void roll();
 
 private:
     std::string letters;
+    Random *rng;
     std::vector<std::vector<std::string> > dice;
 
     // positions[i] = j where i is the board position and j is the die offset
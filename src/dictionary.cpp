@@ -0,0 +1,642 @@
+// This file is part of WGS, a customizable Word Game Solver.
+//
+// Copyright 2014 Robert Gamble <rgamble99@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "dictionary.h"
+#include "scramble.h"
+#include "thread_pool.h"
+
+// Compiled dictionaries are written in native byte order and are not
+// portable between machines with different endianness.
+static const char DICT_MAGIC[8] = { 'W', 'G', 'S', 'D', 'I', 'C', 'T', '\0' };
+static const uint32_t DICT_VERSION = 4;
+static const uint32_t NO_POSITION = 0xffffffffu;
+
+static uint32_t depth_bits(unsigned depth) {
+    // The longest word below a node, as stored in its required cell
+    return std::min(depth, DictNode::MAX_DEPTH) << DictNode::DEPTH_SHIFT;
+}
+
+
+// Builds a minimal acyclic automaton from words added in sorted order
+// (Daciuk et al, "Incremental Construction of Minimal Acyclic Finite-State
+// Automata").  Only the path of the most recently added word is left
+// unminimized, so memory use stays proportional to the finished graph
+// rather than to the equivalent trie.
+class Dictionary::DawgBuilder {
+public:
+    struct Node {
+        bool is_word;
+        std::vector<std::pair<char, uint32_t> > edges;
+    };
+
+    DawgBuilder() : pool(1), free_nodes(), node_register(), previous(),
+        path(1, 0), words(0) {
+        pool[0].is_word = false;
+    }
+
+    void add_word(const std::string &word) {
+        // Words must be uppercase and arrive in sorted order
+        if (words > 0 && word == previous) return;
+
+        size_t common = 0;
+        while (common < word.size() && common < previous.size() &&
+               word[common] == previous[common]) {
+            ++common;
+        }
+
+        minimize(common);
+
+        for (size_t i = common; i < word.size(); ++i) {
+            uint32_t id = new_node();
+            pool[path.back()].edges.push_back(std::make_pair(word[i], id));
+            path.push_back(id);
+        }
+        pool[path.back()].is_word = true;
+        previous = word;
+        words++;
+    }
+
+    void finish() {
+        minimize(0);
+    }
+
+    // The root is always node 0
+    const Node & node(uint32_t id) const { return pool[id]; }
+    size_t node_count() const { return pool.size(); }
+    size_t word_count() const { return words; }
+
+    // An estimate of the memory used by the builder
+    size_t memory_bytes() const {
+        size_t bytes = pool.capacity() * sizeof(Node);
+        for (size_t i = 0; i < pool.size(); ++i) {
+            bytes += pool[i].edges.capacity() * sizeof(pool[i].edges[0]);
+        }
+        for (auto i = node_register.begin(); i != node_register.end(); ++i) {
+            bytes += sizeof(*i) + i->first.capacity() + 2 * sizeof(void *);
+        }
+        return bytes + node_register.bucket_count() * sizeof(void *);
+    }
+
+private:
+    std::vector<Node> pool;
+    std::vector<uint32_t> free_nodes;
+    std::unordered_map<std::string, uint32_t> node_register;
+    std::string previous;
+    std::vector<uint32_t> path;    // path[i] is reached after i letters
+    size_t words;
+
+    uint32_t new_node() {
+        uint32_t id;
+        if (!free_nodes.empty()) {
+            id = free_nodes.back();
+            free_nodes.pop_back();
+        }
+        else {
+            id = pool.size();
+            pool.push_back(Node());
+        }
+        pool[id].is_word = false;
+        pool[id].edges.clear();
+        return id;
+    }
+
+    std::string signature(uint32_t id) const {
+        // Children are already minimized, so two nodes are equivalent
+        // exactly when their flags and outgoing edges are identical.
+        const Node &n = pool[id];
+        std::string sig(1, n.is_word ? '1' : '0');
+        for (size_t i = 0; i < n.edges.size(); ++i) {
+            uint32_t child = n.edges[i].second;
+            sig += n.edges[i].first;
+            sig.append(reinterpret_cast<const char *>(&child), sizeof(child));
+        }
+        return sig;
+    }
+
+    void minimize(size_t down_to) {
+        // Replace the nodes on the previous word's path below down_to with
+        // equivalent nodes already in the graph, or register them.
+        while (path.size() > down_to + 1) {
+            uint32_t child = path.back();
+            path.pop_back();
+            uint32_t parent = path.back();
+
+            std::string sig = signature(child);
+            auto found = node_register.find(sig);
+            if (found != node_register.end()) {
+                pool[parent].edges.back().second = found->second;
+                pool[child].edges.clear();
+                free_nodes.push_back(child);
+            }
+            else {
+                node_register[sig] = child;
+            }
+        }
+    }
+};
+
+Dictionary::Dictionary() :
+    storage(), cells(0), num_cells(0), words(0), nodes(0),
+    map_base(0), map_size(0), build_memory(0) {}
+
+Dictionary::~Dictionary() {
+    unload();
+}
+
+void Dictionary::unload() {
+    if (map_base) {
+        munmap(map_base, map_size);
+        map_base = 0;
+        map_size = 0;
+    }
+    storage.clear();
+    cells = 0;
+    num_cells = words = nodes = build_memory = 0;
+}
+
+bool Dictionary::load(const std::string &filename, bool minimize) {
+    unload();
+
+    std::ifstream dict_file(filename.c_str(), std::ios::binary);
+    if (!dict_file) {
+        std::cerr << "Failed to open dictionary file '" << filename << "'"
+            << std::endl;
+        return false;
+    }
+
+    char magic[sizeof(DICT_MAGIC)];
+    bool compiled = dict_file.read(magic, sizeof(magic)) &&
+        std::memcmp(magic, DICT_MAGIC, sizeof(magic)) == 0;
+    dict_file.close();
+
+    if (compiled) {
+        return load_compiled(filename);
+    }
+    return load_word_list(filename, minimize);
+}
+
+bool Dictionary::load_word_list(const std::string &filename, bool minimize) {
+    // The file is mapped and split into words in place.  A trie is laid
+    // out from the mapped words directly, they are only copied to build a
+    // graph.
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        std::cerr << "Failed to open dictionary file '" << filename << "'"
+            << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    void *base = 0;
+    size_t file_size = 0;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        file_size = st.st_size;
+        base = mmap(0, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+
+    if (base == MAP_FAILED) {
+        std::cerr << "Failed to map dictionary file '" << filename << "'"
+            << std::endl;
+        return false;
+    }
+
+    // Words are separated by whitespace and grouped by first letter, those
+    // starting with anything else are never valid
+    WordRefs buckets[ALPHABET_SIZE];
+    const char *text = static_cast<const char *>(base);
+    for (size_t i = 0; i < file_size; ) {
+        while (i < file_size && std::isspace(text[i])) ++i;
+        size_t start = i;
+        while (i < file_size && !std::isspace(text[i])) ++i;
+        if (i > start && std::isupper(std::toupper(text[start]))) {
+            buckets[std::toupper(text[start]) - 'A'].push_back(
+                std::make_pair(text + start, i - start));
+        }
+    }
+
+    if (!minimize) {
+        build(buckets);
+    }
+    else {
+        // The graph must be built from sorted input, so collect the words
+        // that consist only of letters first.
+        std::vector<std::string> word_list;
+        for (int letter = 0; letter < ALPHABET_SIZE; ++letter) {
+            for (size_t i = 0; i < buckets[letter].size(); ++i) {
+                std::string word(buckets[letter][i].first, buckets[letter][i].second);
+                bool valid = true;
+                for (std::string::iterator c = word.begin(); c != word.end(); ++c) {
+                    *c = std::toupper(*c);
+                    if (!std::isupper(*c)) {
+                        valid = false;
+                        break;
+                    }
+                }
+                if (valid) {
+                    word_list.push_back(word);
+                }
+            }
+        }
+
+        std::sort(word_list.begin(), word_list.end());
+
+        DawgBuilder b;
+        for (size_t i = 0; i < word_list.size(); ++i) {
+            b.add_word(word_list[i]);
+        }
+        b.finish();
+
+        build(b);
+        build_memory = b.memory_bytes();
+        for (size_t i = 0; i < word_list.size(); ++i) {
+            build_memory += sizeof(std::string) + word_list[i].capacity();
+        }
+    }
+
+    if (base) {
+        munmap(base, file_size);
+    }
+    return true;
+}
+
+bool Dictionary::load_compiled(const std::string &filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        std::cerr << "Failed to open dictionary file '" << filename << "'"
+            << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(FileHeader)) {
+        std::cerr << "Dictionary file '" << filename << "' is truncated"
+            << std::endl;
+        close(fd);
+        return false;
+    }
+
+    size_t file_size = st.st_size;
+    void *base = mmap(0, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED) {
+        std::cerr << "Failed to map dictionary file '" << filename << "'"
+            << std::endl;
+        return false;
+    }
+
+    const FileHeader *header = static_cast<const FileHeader *>(base);
+    if (header->version != DICT_VERSION) {
+        std::cerr << "Dictionary file '" << filename << "' has version "
+            << header->version << ", expected version " << DICT_VERSION
+            << "; recompile it with compile-dict" << std::endl;
+        munmap(base, file_size);
+        return false;
+    }
+
+    if (header->cells == 0 ||
+        file_size != sizeof(FileHeader) + header->cells * sizeof(uint32_t)) {
+        std::cerr << "Dictionary file '" << filename << "' is corrupt"
+            << std::endl;
+        munmap(base, file_size);
+        return false;
+    }
+
+    map_base = base;
+    map_size = file_size;
+    cells = reinterpret_cast<const uint32_t *>(header + 1);
+    num_cells = header->cells;
+    words = header->words;
+    nodes = header->nodes;
+    return true;
+}
+
+bool Dictionary::compile(const std::string &filename) const {
+    std::ofstream out(filename.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to create dictionary file '" << filename << "'"
+            << std::endl;
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(header.magic, DICT_MAGIC, sizeof(DICT_MAGIC));
+    header.version = DICT_VERSION;
+    header.words = words;
+    header.nodes = nodes;
+    header.cells = num_cells;
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(cells),
+        num_cells * sizeof(uint32_t));
+    out.close();
+
+    if (!out) {
+        std::cerr << "Failed to write dictionary file '" << filename << "'"
+            << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool all_letters(const std::pair<const char *, size_t> &w) {
+    // Words with anything but letters are never valid
+    for (size_t i = 0; i < w.second; ++i) {
+        if (!std::isupper(std::toupper(w.first[i]))) return false;
+    }
+    return true;
+}
+
+static inline int upper(char c) {
+    // For words already checked to be only letters
+    return c & ~0x20;
+}
+
+static int compare_words(const std::pair<const char *, size_t> &a,
+    const std::pair<const char *, size_t> &b) {
+    // Alphabetical order ignoring case, a prefix sorts first
+    size_t n = std::min(a.second, b.second);
+    for (size_t i = 0; i < n; ++i) {
+        int diff = upper(a.first[i]) - upper(b.first[i]);
+        if (diff != 0) return diff;
+    }
+    return a.second < b.second ? -1 : a.second > b.second;
+}
+
+void Dictionary::build(WordRefs *buckets) {
+    // The words starting with each letter are sorted and laid out straight
+    // from the mapped word list, in parallel when there is more than one
+    // core.  Word lists are usually sorted already, which is checked
+    // first.  Links are relative, so a part laid out on its own can be
+    // placed under the root as it is.
+    std::vector<uint32_t> parts[ALPHABET_SIZE];
+    size_t part_words[ALPHABET_SIZE] = { 0 };
+    size_t part_nodes[ALPHABET_SIZE] = { 0 };
+
+    auto sort_words = [](WordRefs &refs) {
+        refs.erase(std::remove_if(refs.begin(), refs.end(),
+            [](const WordRef &w) { return !all_letters(w); }), refs.end());
+
+        // Lists that are sorted without duplicates, the usual case, are
+        // left as they are
+        auto not_before = [](const WordRef &a, const WordRef &b) { return compare_words(a, b) >= 0; };
+        if (std::adjacent_find(refs.begin(), refs.end(), not_before) != refs.end()) {
+            std::sort(refs.begin(), refs.end(),
+                [](const WordRef &a, const WordRef &b) { return compare_words(a, b) < 0; });
+            refs.erase(std::unique(refs.begin(), refs.end(),
+                [](const WordRef &a, const WordRef &b) { return compare_words(a, b) == 0; }),
+                refs.end());
+        }
+    };
+
+    size_t threads = std::min<size_t>(ThreadPool::hardware_threads(), ALPHABET_SIZE);
+    if (threads > 1) {
+        ThreadPool pool(threads);
+        for (int letter = 0; letter < ALPHABET_SIZE; ++letter) {
+            if (buckets[letter].empty()) continue;
+
+            pool.submit([&, letter](size_t) {
+                WordRefs &refs = buckets[letter];
+                sort_words(refs);
+                if (!refs.empty()) {
+                    flatten(&refs[0], &refs[0] + refs.size(), 1, parts[letter],
+                        part_words[letter], part_nodes[letter]);
+                }
+            });
+        }
+        pool.wait();
+    }
+    else {
+        for (int letter = 0; letter < ALPHABET_SIZE; ++letter) {
+            sort_words(buckets[letter]);
+        }
+    }
+
+    storage.clear();
+    words = 0;
+    nodes = 1;
+    build_memory = 0;
+
+    uint32_t info = 0;
+    for (int letter = 0; letter < ALPHABET_SIZE; ++letter) {
+        if (!buckets[letter].empty()) {
+            info |= 1u << letter;
+        }
+    }
+
+    size_t num_children = popcount32(info);
+    storage.resize(2 + 2 * num_children);
+    storage[0] = info;
+
+    // Without parts from the pool each letter is laid out in place
+    uint32_t required = num_children ? DictNode::LETTER_MASK : 0;
+    unsigned depth = 0;
+    size_t i = 0;
+    for (int letter = 0; letter < ALPHABET_SIZE; ++letter) {
+        WordRefs &refs = buckets[letter];
+        std::vector<uint32_t> &part = parts[letter];
+        build_memory += refs.capacity() * sizeof(WordRef) +
+            part.capacity() * sizeof(uint32_t);
+        if (refs.empty()) continue;
+
+        size_t child_pos = storage.size();
+        storage[2 + num_children + i] = words;
+        storage[2 + i] = child_pos;
+        if (part.empty()) {
+            flatten(&refs[0], &refs[0] + refs.size(), 1, storage, words, nodes);
+        }
+        else {
+            storage.insert(storage.end(), part.begin(), part.end());
+            std::vector<uint32_t>().swap(part);
+            words += part_words[letter];
+            nodes += part_nodes[letter];
+        }
+        required &= storage[child_pos + 1] | (1u << letter);
+        depth = std::max(depth, (storage[child_pos + 1] >> DictNode::DEPTH_SHIFT) + 1);
+        ++i;
+    }
+    storage[1] = required | depth_bits(depth);
+
+    cells = &storage[0];
+    num_cells = storage.size();
+}
+
+size_t Dictionary::flatten(const WordRef *begin, const WordRef *end, size_t length,
+    std::vector<uint32_t> &out, size_t &words, size_t &nodes) {
+    // Lays out the node for the first length letters of the sorted,
+    // distinct words from begin to end, which all share them.  Nodes are
+    // laid out in depth-first order so that a node's first child usually
+    // follows it directly.  Returns the position of the new node.
+    size_t pos = out.size();
+    size_t first_word = words;
+    uint32_t info = 0;
+
+    // A word ending here sorts before the longer words
+    bool ends_here = begin->second == length;
+    if (ends_here) {
+        info |= DictNode::WORD_FLAG;
+        words++;
+        ++begin;
+    }
+    nodes++;
+
+    // The words for each child are the run with the same next letter
+    const WordRef *children[ALPHABET_SIZE + 1];
+    size_t num_children = 0;
+    for (const WordRef *w = begin; w != end; ) {
+        int letter = upper(w->first[length]);
+        info |= 1u << (letter - 'A');
+        children[num_children++] = w;
+        while (w != end && upper(w->first[length]) == letter) ++w;
+    }
+    children[num_children] = end;
+
+    out.push_back(info);
+    out.resize(pos + 2 + 2 * num_children);
+
+    // A word ending here needs nothing more, otherwise every word needs
+    // one of the child letters and whatever that child requires
+    uint32_t required = DictNode::LETTER_MASK;
+    unsigned depth = 0;
+    uint32_t letters = info & DictNode::LETTER_MASK;
+    for (size_t i = 0; i < num_children; ++i) {
+        // Words are numbered in the order they are reached
+        out[pos + 2 + num_children + i] = words - first_word;
+        size_t child_pos = flatten(children[i], children[i + 1], length + 1, out, words, nodes);
+        out[pos + 2 + i] = child_pos - pos;
+        required &= out[child_pos + 1] | (letters & -letters);
+        depth = std::max(depth, (out[child_pos + 1] >> DictNode::DEPTH_SHIFT) + 1);
+        letters &= letters - 1;
+    }
+    out[pos + 1] = ((ends_here || num_children == 0) ? 0 : required) | depth_bits(depth);
+    return pos;
+}
+
+void Dictionary::build(const DawgBuilder &b) {
+    storage.clear();
+    nodes = 0;
+    words = b.word_count();
+    std::vector<uint32_t> positions(b.node_count(), NO_POSITION);
+    std::vector<uint32_t> counts(b.node_count(), 0);
+    flatten(b, 0, positions, counts);
+    cells = &storage[0];
+    num_cells = storage.size();
+}
+
+size_t Dictionary::flatten(const DawgBuilder &b, uint32_t id,
+    std::vector<uint32_t> &positions, std::vector<uint32_t> &counts) {
+    // Same layout as the trie, except that a node shared by several parents
+    // is written once, so links may point backwards.  counts[id] is set to
+    // the number of words starting at the node.
+    if (positions[id] != NO_POSITION) {
+        return positions[id];
+    }
+
+    const DawgBuilder::Node &n = b.node(id);
+    size_t pos = storage.size();
+    size_t num_children = n.edges.size();
+    uint32_t info = n.is_word ? DictNode::WORD_FLAG : 0;
+
+    for (size_t i = 0; i < num_children; ++i) {
+        info |= 1u << (n.edges[i].first - 'A');
+    }
+
+    positions[id] = pos;
+    nodes++;
+
+    storage.push_back(info);
+    storage.resize(pos + 2 + 2 * num_children);
+
+    uint32_t count = n.is_word ? 1 : 0;
+    uint32_t required = DictNode::LETTER_MASK;
+    unsigned depth = 0;
+    for (size_t i = 0; i < num_children; ++i) {
+        uint32_t child = n.edges[i].second;
+        size_t child_pos = flatten(b, child, positions, counts);
+        // Backward links wrap around to negative offsets
+        storage[pos + 2 + i] = (uint32_t) (child_pos - pos);
+        storage[pos + 2 + num_children + i] = count;
+        count += counts[child];
+        required &= storage[child_pos + 1] | (1u << (n.edges[i].first - 'A'));
+        depth = std::max(depth, (storage[child_pos + 1] >> DictNode::DEPTH_SHIFT) + 1);
+    }
+    storage[pos + 1] = ((n.is_word || num_children == 0) ? 0 : required) | depth_bits(depth);
+    counts[id] = count;
+    return pos;
+}
+
+bool Dictionary::is_a_word(const char *word) const {
+    // lookup a word starting at the root
+    if (!word || !cells) return false;
+
+    const DictNode *t = root();
+    for (; *word && t; ++word) {
+        t = t->child(std::toupper(*word));
+    }
+    return t && t->is_a_word();
+}
+
+uint32_t Dictionary::word_id(const char *word) const {
+    if (!word || !cells) return NO_WORD;
+
+    uint32_t id = 0;
+    const DictNode *t = root();
+    for (; *word && t; ++word) {
+        t = t->child(std::toupper(*word), id);
+    }
+    return t && t->is_a_word() ? id : NO_WORD;
+}
+
+std::string Dictionary::word(uint32_t id) const {
+    // Descend into the last child whose words start at or before id
+    std::string result;
+    if (!cells || id >= words) return result;
+
+    const DictNode *t = root();
+    for (;;) {
+        if (t->is_a_word()) {
+            if (id == 0) return result;
+        }
+
+        unsigned n = t->num_children();
+        if (n == 0) return "";
+        while (n > 1 && t->words_before(n - 1) > id) {
+            --n;
+        }
+        --n;
+
+        uint32_t letters = t->child_letters();
+        for (unsigned i = 0; i < n; ++i) {
+            letters &= letters - 1;
+        }
+        result += 'A' + popcount32((letters & -letters) - 1);
+
+        id -= t->words_before(n);
+        t = t->nth_child(n);
+    }
+}
@@ -0,0 +1,184 @@
+// This file is part of WGS, a customizable Word Game Solver.
+//
+// Copyright 2014 Robert Gamble <rgamble99@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WGS_DICTIONARY_H
+#define WGS_DICTIONARY_H
+
+#include <cctype>
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+inline unsigned popcount32(uint32_t x) {
+#ifdef __GNUC__
+    return __builtin_popcount(x);
+#else
+    x = x - ((x >> 1) & 0x55555555);
+    x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+    return (((x + (x >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+#endif
+}
+
+
+// A node in a compiled dictionary.
+//
+// A compiled dictionary is a flat array of 32-bit cells.  Each node is a
+// variable length record starting with an info cell, which holds one bit
+// per child letter ('A' is bit 0) and the end-of-word flag.  Next is a cell
+// with one bit for each letter that every word below the node still needs
+// and, in the top bits, the length of the longest word ending below the
+// node.  Then comes one cell per child giving the signed distance, in
+// cells, from this node to the child.  Because all links are relative the array can be
+// mapped directly from a file and walked in place.
+//
+// After the links comes one cell per child holding the number of words
+// that sort before the child's words among the words starting at this
+// node.  Summing these along the path to a word gives the word's position
+// in alphabetical order, its word ID.
+class DictNode {
+public:
+    static const uint32_t WORD_FLAG = 0x80000000u;
+    static const uint32_t LETTER_MASK = 0x03ffffffu;
+    static const unsigned DEPTH_SHIFT = 26;
+    static const unsigned MAX_DEPTH = 63;
+
+    bool is_a_word() const { return (info & WORD_FLAG) != 0; }
+    uint32_t child_letters() const { return info & LETTER_MASK; }
+    unsigned num_children() const { return popcount32(info & LETTER_MASK); }
+
+    // The letters that appear in the rest of every word below this node,
+    // so no word can be finished from here without all of them
+    uint32_t required_letters() const { return (&info)[1] & LETTER_MASK; }
+
+    // The most letters that follow this node in any word, limited to
+    // MAX_DEPTH
+    unsigned max_depth() const { return (&info)[1] >> DEPTH_SHIFT; }
+
+    const DictNode * child(char c) const {
+        // Assumes uppercase characters have sequential values
+        if (!std::isupper(c)) return 0;
+        uint32_t bit = 1u << (c - 'A');
+        if (!(info & bit)) return 0;
+        return nth_child(popcount32(info & (bit - 1)));
+    }
+
+    // As above, also adding the child's offset to word_id
+    const DictNode * child(char c, uint32_t &word_id) const {
+        if (!std::isupper(c)) return 0;
+        uint32_t bit = 1u << (c - 'A');
+        if (!(info & bit)) return 0;
+        unsigned n = popcount32(info & (bit - 1));
+        word_id += words_before(n);
+        return nth_child(n);
+    }
+
+    // The children in letter order, n must be less than the number of
+    // bits set in child_letters()
+    const DictNode * nth_child(unsigned n) const {
+        const uint32_t *edges = &info + 2;
+        return reinterpret_cast<const DictNode *>(&info + (int32_t) edges[n]);
+    }
+
+    // The number of words starting at this node which come before those
+    // of the nth child
+    uint32_t words_before(unsigned n) const {
+        const uint32_t *edges = &info + 2;
+        return edges[num_children() + n];
+    }
+
+private:
+    uint32_t info;
+    DictNode();
+};
+
+
+class Dictionary {
+public:
+    Dictionary();
+    ~Dictionary();
+
+    // Load a dictionary file, which may either be a plain word list with
+    // one word per line or a file previously written by compile().  Word
+    // lists are stored as a trie unless minimize is set, in which case
+    // common suffixes are merged to form a directed acyclic word graph.
+    // A word list is laid out again on every load, in time proportional
+    // to its size, while a compiled file is only mapped.
+    bool load(const std::string &filename, bool minimize = false);
+
+    // Write the dictionary in compiled form
+    bool compile(const std::string &filename) const;
+
+    const DictNode * root() const
+        { return reinterpret_cast<const DictNode *>(cells); }
+    bool is_a_word(const char *word) const;
+
+    // Words are numbered from 0 in alphabetical order.  Returns NO_WORD or
+    // an empty string if there is no such word.
+    static const uint32_t NO_WORD = 0xffffffffu;
+    uint32_t word_id(const char *word) const;
+    std::string word(uint32_t id) const;
+
+    size_t word_count() const { return words; }
+    size_t node_count() const { return nodes; }
+    size_t size_bytes() const { return num_cells * sizeof(uint32_t); }
+    bool is_mapped() const { return map_base != 0; }
+
+    // The memory used by the intermediate structure the dictionary was
+    // built from, 0 for compiled files
+    size_t build_bytes() const { return build_memory; }
+
+private:
+    // Compiled files start with this header, the cells follow immediately
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t words;
+        uint32_t nodes;
+        uint32_t cells;
+    };
+
+    std::vector<uint32_t> storage;  // cells built from a word list
+    const uint32_t *cells;
+    size_t num_cells;
+    size_t words;
+    size_t nodes;
+    void *map_base;                 // non-null when cells are mapped
+    size_t map_size;
+    size_t build_memory;
+
+    class DawgBuilder;
+
+    // Words as they appear in a mapped word list
+    typedef std::pair<const char *, size_t> WordRef;
+    typedef std::vector<WordRef> WordRefs;
+
+    bool load_compiled(const std::string &filename);
+    bool load_word_list(const std::string &filename, bool minimize);
+    void build(WordRefs *buckets);
+    void build(const DawgBuilder &b);
+    static size_t flatten(const WordRef *begin, const WordRef *end, size_t length,
+        std::vector<uint32_t> &out, size_t &words, size_t &nodes);
+    size_t flatten(const DawgBuilder &b, uint32_t id,
+        std::vector<uint32_t> &positions, std::vector<uint32_t> &counts);
+    void unload();
+    Dictionary(const Dictionary &);
+    Dictionary& operator=(const Dictionary &);
+};
+
+#endif
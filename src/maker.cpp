@@ -17,60 +17,133 @@
 
 #include "maker.h"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <fstream>
 #include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
 #include <vector>
+#include <sstream>
 #include <string>
 #include <numeric>
 #include "dice.h"
+#include "thread_pool.h"
 #include "wgs_json.h"
 
-static std::string generate_simple_dice_board(const GameRuleSet &grs);
-static std::string generate_simple_prop_board(const GameRuleSet &grs);
-static std::string generate_simple_list_board(const GameRuleSet &grs);
-
-static std::string generate_dice_board(const GameRuleSet &grs,
-    Solver &s, size_t min_words, size_t min_score, bool reverse_target = false);
-static std::string generate_prop_board(const GameRuleSet &grs,
-    Solver &s, size_t min_words, size_t min_score, bool reverse_target = false);
-
-std::string generate_simple_board(const GameRuleSet &grs) {
+static std::string generate_simple_dice_board(const GameRuleSet &grs, Random &rng);
+static std::string generate_simple_prop_board(const GameRuleSet &grs, Random &rng);
+static std::string generate_simple_list_board(const GameRuleSet &grs, Random &rng);
+
+class DiceTiles {
+    // The tiles of a board made from dice, changed by rolling a die or
+    // swapping two.  The dice are rolled with rng, which must outlive them.
+public:
+    DiceTiles(const GameRuleSet &grs, Random &rng);
+    size_t size() const { return num_dice; }
+    std::string letters() const { return dice.get_letters(); }
+    bool can_change() const { return true; }
+
+    // Make a random change, returning the tiles changed as a mask
+    uint64_t change();
+
+private:
+    Random *rng;
+    Dice dice;
+    size_t num_dice;
+    bool is_anagram;
+
+    static std::vector<std::vector<std::string> > choose_dice(const GameRuleSet &grs, Random &rng);
+};
+
+class PropTiles {
+    // The tiles of a board made from a letter propensity list, changed by
+    // replacing a letter or swapping two.  Letters sampled without
+    // replacement are replaced from the pool of those left over.
+public:
+    PropTiles(const GameRuleSet &grs, Random &rng);
+    size_t size() const { return tiles.size(); }
+    std::string letters() const { return std::accumulate(tiles.begin(), tiles.end(), std::string("")); }
+    bool can_change() const { return !(is_anagram && without_replacement && pool.empty()); }
+    uint64_t change();
+
+private:
+    Random *rng;
+    const std::vector<std::string> *prop_letters;
+    std::vector<std::string> tiles;
+    std::vector<std::string> pool;
+    bool is_anagram;
+    bool without_replacement;
+};
+
+template <class Tiles>
+static std::string anneal(const GameRuleSet &grs, Solver &s, Tiles best,
+    size_t min_words, size_t min_score, bool reverse_target, Solver::Score *totals, size_t *scored);
+template <class Tiles>
+static std::string temper(const GameRuleSet &grs, Solver &s, Random &rng,
+    size_t min_words, size_t min_score, bool reverse_target, Solver::Score *totals, size_t *scored,
+    const TemperingSchedule &schedule);
+static size_t shortfall(const Solver::Score &score, size_t min_words, size_t min_score, bool reverse_target);
+typedef std::chrono::steady_clock Clock;
+static void trace_best(Clock::time_point start, size_t iterations, const Solver::Score &score);
+
+static bool start_rescoring(const GameRuleSet &grs, Solver &s,
+    const std::string &letters, size_t tiles, Solver::PathSet &paths, Solver::Score *score = 0);
+static Solver::Score score_candidate(const GameRuleSet &grs, Solver &s,
+    const std::string &letters, size_t tiles, uint64_t changed,
+    bool &rescoring, const Solver::PathSet &best_paths, Solver::PathSet &paths);
+
+std::string generate_simple_board(const GameRuleSet &grs, Random &rng) {
     GameLetterDistribution *ld = grs.letters;
     if (!ld) return "";
 
     if (ld->generationMethod() == "Dice") {
-        return generate_simple_dice_board(grs);
+        return generate_simple_dice_board(grs, rng);
     }
 
     if (ld->generationMethod() == "LetterPropensity") {
-        return generate_simple_prop_board(grs);
+        return generate_simple_prop_board(grs, rng);
     }
 
     if (ld->generationMethod() == "WordList") {
-        return generate_simple_list_board(grs);
+        return generate_simple_list_board(grs, rng);
     }
 
     return "";
 }
 
 
-std::string generate_board(const GameRuleSet &grs, Solver &s, size_t min_words, size_t min_score, bool reverse_target) {
+std::string generate_board(const GameRuleSet &grs, Solver &s, Random &rng, size_t min_words, size_t min_score, bool reverse_target, Solver::Score *score, size_t *iterations, const TemperingSchedule *schedule) {
+    if (score) {
+        score->words = score->points = 0;
+    }
+
     GameLetterDistribution *ld = grs.letters;
     if (!ld) return "";
 
+    bool tempering = schedule && schedule->replicas > 0;
     if (ld->generationMethod() == "Dice") {
-        return generate_dice_board(grs, s, min_words, min_score, reverse_target);
+        if (tempering) {
+            return temper<DiceTiles>(grs, s, rng, min_words, min_score, reverse_target, score, iterations, *schedule);
+        }
+        return anneal(grs, s, DiceTiles(grs, rng), min_words, min_score, reverse_target, score, iterations);
     }
 
     if (ld->generationMethod() == "LetterPropensity") {
-        return generate_prop_board(grs, s, min_words, min_score, reverse_target);
+        if (tempering) {
+            return temper<PropTiles>(grs, s, rng, min_words, min_score, reverse_target, score, iterations, *schedule);
+        }
+        return anneal(grs, s, PropTiles(grs, rng), min_words, min_score, reverse_target, score, iterations);
     }
 
     return "";
 }
 
 
-std::string generate_simple_dice_board(const GameRuleSet &grs) {
+std::string generate_simple_dice_board(const GameRuleSet &grs, Random &rng) {
     GameLetterDistribution *ld = grs.letters;
     size_t max_letters = grs.scoring_rules->randomBoardSize();
     if (max_letters == 0 or grs.grid->tilesSet() < max_letters) {
@@ -81,7 +154,7 @@ std::string generate_simple_dice_board(const GameRuleSet &grs) {
     auto dice = ld->dice;
 
     if (ld->shuffleDice()) {
-        random_shuffle(dice.begin(), dice.end());
+        rng.shuffle(dice);
     }
 
     if (dice.size() > max_letters) {
@@ -90,7 +163,7 @@ std::string generate_simple_dice_board(const GameRuleSet &grs) {
     }
         
     for (auto iter = dice.begin(); iter != dice.end(); ++iter) {
-        board.push_back(iter->at(rand() % iter->size()));
+        board.push_back(iter->at(rng.below(iter->size())));
         if (board.size() == max_letters) {
             break;
         }
@@ -99,7 +172,7 @@ std::string generate_simple_dice_board(const GameRuleSet &grs) {
 }
 
 
-std::string generate_simple_prop_board(const GameRuleSet &grs) {
+std::string generate_simple_prop_board(const GameRuleSet &grs, Random &rng) {
     GameLetterDistribution *ld = grs.letters;
     size_t max_letters = grs.scoring_rules->randomBoardSize();
     if (max_letters == 0 or grs.grid->tilesSet() < max_letters) {
@@ -114,14 +187,14 @@ std::string generate_simple_prop_board(const GameRuleSet &grs) {
             if (i == letters.size()) {
                 break;
             }
-            int j = i + (rand() % (letters.size() - i));
+            int j = i + rng.below(letters.size() - i);
             board.push_back(letters[j]);
             std::swap(letters[i], letters[j]);
         }
     }
     else {
         for (size_t i = 0; i < max_letters; ++i) {
-            board.push_back(letters[rand() % letters.size()]);
+            board.push_back(letters[rng.below(letters.size())]);
         }
     }
 
@@ -129,7 +202,7 @@ std::string generate_simple_prop_board(const GameRuleSet &grs) {
 }
 
 
-std::string generate_simple_list_board(const GameRuleSet &grs) {
+std::string generate_simple_list_board(const GameRuleSet &grs, Random &rng) {
     std::string board;
     std::string line;
     size_t lines = 1;
@@ -142,7 +215,7 @@ std::string generate_simple_list_board(const GameRuleSet &grs) {
     }
 
     while (word_list >> line) {
-        if (rand() / (double) RAND_MAX <= 1.0 / lines) {
+        if (rng.below(lines) == 0) {
             board = line;
         }
         ++lines;
@@ -158,7 +231,7 @@ std::string generate_simple_list_board(const GameRuleSet &grs) {
             std::string word_mult(b.word_mult(i) - 1, ';');
             board_tiles.push_back(letter_mult + word_mult + b.tile(i) == "" ? "." : b.tile(i));
         }
-        random_shuffle(board_tiles.begin(), board_tiles.end());
+        rng.shuffle(board_tiles);
         board = std::accumulate(board_tiles.begin(), board_tiles.end(),
             std::string(""));
     }
@@ -166,209 +239,419 @@ std::string generate_simple_list_board(const GameRuleSet &grs) {
 }
 
 
-std::string generate_dice_board(const GameRuleSet &grs, Solver &s, size_t min_words, size_t min_score, bool reverse_target) {
+DiceTiles::DiceTiles(const GameRuleSet &grs, Random &_rng) :
+    rng(&_rng), dice(choose_dice(grs, _rng), _rng), num_dice(dice.size()),
+    is_anagram(grs.grid->adjacency() == "Full") {
+    dice.roll();
+}
+
+
+std::vector<std::vector<std::string> > DiceTiles::choose_dice(const GameRuleSet &grs, Random &rng) {
     GameLetterDistribution *ld = grs.letters;
-    bool is_anagram = false;
-    if (grs.grid->adjacency() == "Full") {
-        is_anagram = true;
-    }
     size_t max_letters = grs.scoring_rules->randomBoardSize();
     if (max_letters == 0 or grs.grid->tilesSet() < max_letters) {
         max_letters = grs.grid->tilesSet();
     }
 
-    int max_duds = 200;
-    size_t best_score = -reverse_target;
-    size_t best_points = -reverse_target;
-    int duds = 0;
-    int changes = 1;
-    int iterations = 0;
     auto dice = ld->dice;
 
     if (ld->shuffleDice()) {
-        random_shuffle(dice.begin(), dice.end());
+        rng.shuffle(dice);
     }
 
     if (dice.size() > max_letters) {
         // Get rid of extra dice
         dice.erase(dice.begin() + max_letters, dice.end());
     }
-        
-    int num_dice = dice.size();
-    Dice best(dice);
-    best.roll();
+    return dice;
+}
 
-    do {
-        iterations++;
-        Dice tmp(best);
 
-        /* Don't do a die swap if anagram, anagrams are already fully connected */
-        if (is_anagram || (rand() % 2)) {
-            int i = rand() % num_dice;
-            tmp.roll(i);
-        } 
-        else {
-            // Swap die
-            int i = rand() % num_dice;
-            int j = rand() % num_dice;
-            tmp.swap_dice(i, j);
+uint64_t DiceTiles::change() {
+    /* Don't do a die swap if anagram, anagrams are already fully connected */
+    if (is_anagram || rng->below(2)) {
+        int i = rng->below(num_dice);
+        dice.roll(i);
+        return uint64_t(1) << (i % MAX_MASK_TILES);
+    }
+
+    // Swap die
+    int i = rng->below(num_dice);
+    int j = rng->below(num_dice);
+    dice.swap_dice(i, j);
+    return (uint64_t(1) << (i % MAX_MASK_TILES)) | (uint64_t(1) << (j % MAX_MASK_TILES));
+}
+
+
+PropTiles::PropTiles(const GameRuleSet &grs, Random &_rng) :
+    rng(&_rng), prop_letters(&grs.letters->propensity_list),
+    is_anagram(grs.grid->adjacency() == "Full"),
+    without_replacement(grs.letters->sampleWithoutReplacement()) {
+    size_t max_letters = grs.scoring_rules->randomBoardSize();
+    if (max_letters == 0 or grs.grid->tilesSet() < max_letters) {
+        max_letters = grs.grid->tilesSet();
+    }
+
+    if (without_replacement) {
+        std::vector<std::string> remaining(*prop_letters);
+        size_t i;
+        for (i = 0; i < max_letters; ++i) {
+            if (i == remaining.size()) {
+                break;
+            }
+            int j = i + rng->below(remaining.size() - i);
+            tiles.push_back(remaining[j]);
+            std::swap(remaining[i], remaining[j]);
         }
+        if (i < remaining.size()) {
+            std::copy(remaining.begin() + i, remaining.end(), back_inserter(pool));
+        }
+    }
+    else {
+        for (size_t i = 0; i < max_letters; ++i) {
+            tiles.push_back((*prop_letters)[rng->below(prop_letters->size())]);
+        }
+    }
+}
 
-        std::string letters = tmp.get_letters();
-        Board b(letters, grs.grid);
-        s.solve(&b, *grs.scoring_rules);
 
-        Solver::SolutionList solutions = s.get_solutions();
-        sort(solutions.begin(), solutions.end());
-        solutions.erase(unique(solutions.begin(), solutions.end(), equal_words), solutions.end());
+uint64_t PropTiles::change() {
+    /* Don't do a die swap if anagram, anagrams are already fully connected */
+    if (is_anagram || (rng->below(2) && !(without_replacement && pool.size() == 0))) {
+        /* Change one of the letters */
+        int i = rng->below(tiles.size());
+        if (without_replacement) {
+            // Swap with a remaining pool letter
+            int j = rng->below(pool.size());
+            std::swap(tiles[i], pool[j]);
+        }
+        else {
+            int j = rng->below(prop_letters->size());
+            tiles[i] = (*prop_letters)[j];
+        }
+        return uint64_t(1) << (i % MAX_MASK_TILES);
+    }
+
+    // Swap die
+    int i = rng->below(tiles.size());
+    int j = rng->below(tiles.size());
+    std::swap(tiles[i], tiles[j]);
+    return (uint64_t(1) << (i % MAX_MASK_TILES)) | (uint64_t(1) << (j % MAX_MASK_TILES));
+}
 
-        size_t board_score = solutions.size();
-        size_t board_points = 0;    
 
-        for(Solver::SolutionList::iterator i = solutions.begin(); i != solutions.end(); ++i) {
-            board_points += i->get_score();
+template <class Tiles>
+std::string anneal(const GameRuleSet &grs, Solver &s, Tiles best, size_t min_words, size_t min_score, bool reverse_target, Solver::Score *totals, size_t *scored) {
+    if (!best.can_change()) {
+        std::string board = best.letters();
+        if (totals) {
+            Board b(board, grs.grid);
+            *totals = s.score(&b, *grs.scoring_rules);
+        }
+        if (scored) {
+            *scored = 0;
         }
+        return board;
+    }
+
+    int max_duds = 200;
+    size_t best_score = -reverse_target;
+    size_t best_points = -reverse_target;
+    int duds = 0;
+    int changes = 1;
+    int iterations = 0;
+
+    Solver::PathSet best_paths, tmp_paths;
+    bool rescoring = start_rescoring(grs, s, best.letters(), best.size(), best_paths);
+
+    do {
+        iterations++;
+        Tiles tmp(best);
+        uint64_t changed = tmp.change();
+
+        Solver::Score score = score_candidate(grs, s, tmp.letters(), tmp.size(), changed,
+            rescoring, best_paths, tmp_paths);
+
+        size_t board_score = score.words;
+        size_t board_points = score.points;
 
         if (
-            (reverse_target && ((board_score < best_score || board_points < best_points) or 
+            (reverse_target && ((board_score < best_score || board_points < best_points) or
              ( (int)(board_score - best_score) < (250 / (changes) ) ))) ||
-            (!reverse_target && ((board_score > best_score || board_points > best_points) or 
+            (!reverse_target && ((board_score > best_score || board_points > best_points) or
              ( (int)(best_score - board_score) < (250 / (changes) ) )))
-            ) 
+            )
         {
             best = tmp;
             best_score = board_score;
             best_points = board_points;
+            best_paths.swap(tmp_paths);
             duds = 0;
             changes++;
         }
         else {
             duds++;
         }
-            
+
     } while (duds < max_duds and (
         (!reverse_target && (best_score < min_words || best_points < min_score)) ||
         (reverse_target && (best_score > min_words || best_points > min_score)) ));
 
-    std::string result = best.get_letters();
-    return result;
-} 
+    // The first candidate is always accepted, so the best board has been
+    // scored
+    if (totals) {
+        totals->words = best_score;
+        totals->points = best_points;
+    }
+    if (scored) {
+        *scored = iterations;
+    }
+    return best.letters();
+}
 
 
-std::string generate_prop_board(const GameRuleSet &grs, Solver &s, size_t min_words, size_t min_score, bool reverse_target) {
-    GameLetterDistribution *ld = grs.letters;
-    bool is_anagram = false;
-    if (grs.grid->adjacency() == "Full") {
-        is_anagram = true;
+size_t shortfall(const Solver::Score &score, size_t min_words, size_t min_score, bool reverse_target) {
+    // How far a board is from the target, zero once it is met
+    if (reverse_target) {
+        return (score.words > min_words ? score.words - min_words : 0) +
+            (score.points > min_score ? score.points - min_score : 0);
     }
+    return (score.words < min_words ? min_words - score.words : 0) +
+        (score.points < min_score ? min_score - score.points : 0);
+}
 
-    size_t max_letters = grs.scoring_rules->randomBoardSize();
-    if (max_letters == 0 or grs.grid->tilesSet() < max_letters) {
-        max_letters = grs.grid->tilesSet();
-    }
 
-    int max_duds = 200;
-    size_t best_score = -reverse_target;
-    size_t best_points = -reverse_target;
-    int duds = 0;
-    int changes = 1;
-    int iterations = 0;
-    size_t num_letters = max_letters;
-    std::vector<std::string> best;
-    std::vector<std::string> pool;
-    std::vector<std::string> prop_letters(ld->propensity_list);
+template <class Tiles>
+class Replica {
+    // One of the boards annealed by tempering.  Each has its own random
+    // stream and solver so that the replicas can be stepped at once.
+public:
+    Replica(const GameRuleSet &grs, const Dictionary &dict, const Random &_rng,
+        size_t min_words, size_t min_score, bool reverse_target);
+
+    // Score up to steps candidates at the given temperature, stopping
+    // early once the target is met
+    void step(const GameRuleSet &grs, double temperature, size_t steps);
+
+    Random rng;
+    Solver solver;
+    Tiles tiles;
+    Solver::Score score;
+    size_t energy;          // the shortfall of tiles
+    size_t iterations;
+    std::string best;       // the board with the lowest shortfall found
+    Solver::Score best_score;
+    size_t best_energy;
+
+private:
+    size_t min_words;
+    size_t min_score;
+    bool reverse_target;
+    bool rescoring;
+    Solver::PathSet paths;
+    Solver::PathSet tmp_paths;
+};
+
+
+template <class Tiles>
+Replica<Tiles>::Replica(const GameRuleSet &grs, const Dictionary &dict, const Random &_rng, size_t _min_words, size_t _min_score, bool _reverse_target) :
+    rng(_rng), solver(dict), tiles(grs, rng), iterations(0),
+    min_words(_min_words), min_score(_min_score), reverse_target(_reverse_target) {
+    best = tiles.letters();
+    rescoring = start_rescoring(grs, solver, best, tiles.size(), paths, &score);
+    energy = shortfall(score, min_words, min_score, reverse_target);
+    best_score = score;
+    best_energy = energy;
+}
 
-    if (ld->sampleWithoutReplacement()) {
-        size_t i;
-        for (i = 0; i < max_letters; ++i) {
-            if (i == prop_letters.size()) {
-                num_letters = i;
-                break;
-            }
-            int j = i + (rand() % (prop_letters.size() - i));
-            best.push_back(prop_letters[j]);
-            std::swap(prop_letters[i], prop_letters[j]);
+
+template <class Tiles>
+void Replica<Tiles>::step(const GameRuleSet &grs, double temperature, size_t steps) {
+    // A worse candidate is accepted with a chance that falls off
+    // exponentially with how much worse it is, more slowly the hotter
+    // the replica
+    for (size_t i = 0; i < steps && energy > 0 && tiles.can_change(); ++i) {
+        ++iterations;
+        Tiles tmp(tiles);
+        uint64_t changed = tmp.change();
+        std::string letters = tmp.letters();
+        Solver::Score tmp_score = score_candidate(grs, solver, letters, tmp.size(),
+            changed, rescoring, paths, tmp_paths);
+        size_t tmp_energy = shortfall(tmp_score, min_words, min_score, reverse_target);
+
+        if (tmp_energy > energy &&
+            rng.uniform() >= std::exp((double(energy) - tmp_energy) / temperature)) {
+            continue;
         }
-        if (i < prop_letters.size()) {
-            pool.clear();
-            std::copy(prop_letters.begin() + i, prop_letters.end(), back_inserter(pool));
+
+        tiles = tmp;
+        score = tmp_score;
+        energy = tmp_energy;
+        paths.swap(tmp_paths);
+        if (energy < best_energy) {
+            best.swap(letters);
+            best_score = score;
+            best_energy = energy;
         }
     }
-    else {
-        for (size_t i = 0; i < max_letters; ++i) {
-            best.push_back(prop_letters[rand() % prop_letters.size()]);
+}
+
+
+void trace_best(Clock::time_point start, size_t iterations, const Solver::Score &score) {
+    // Written as a single string so lines from boards made at once do not
+    // run together
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    std::stringstream line;
+    line << "trace seconds=" << elapsed.count() << " iterations=" << iterations
+        << " words=" << score.words << " points=" << score.points << std::endl;
+    std::cerr << line.str();
+}
+
+
+template <class Tiles>
+std::string temper(const GameRuleSet &grs, Solver &s, Random &rng, size_t min_words, size_t min_score, bool reverse_target, Solver::Score *totals, size_t *scored, const TemperingSchedule &schedule) {
+    Clock::time_point start = Clock::now();
+
+    // Each replica draws from its own stream, so the boards made do not
+    // depend on how many replicas are stepped at once.  The streams are
+    // from a new seed as those after rng may be used for other boards.
+    // ladder[k] is the replica at temperatures[k], coldest first.
+    std::vector<std::unique_ptr<Replica<Tiles> > > replicas;
+    std::vector<Replica<Tiles> *> ladder;
+    std::vector<double> temperatures;
+    uint64_t seed = rng.next();
+    for (size_t k = 0; k < schedule.replicas; ++k) {
+        replicas.push_back(std::unique_ptr<Replica<Tiles> >(new Replica<Tiles>(
+            grs, s.get_dictionary(), Random(seed, k), min_words, min_score, reverse_target)));
+        ladder.push_back(replicas.back().get());
+
+        double t = schedule.min_temperature;
+        if (schedule.replicas > 1) {
+            t *= std::pow(schedule.max_temperature / schedule.min_temperature,
+                double(k) / (schedule.replicas - 1));
         }
+        temperatures.push_back(t);
     }
 
-    if (is_anagram && ld->sampleWithoutReplacement() && pool.empty()) {
-        /* For anagram games, the letter graph is already fully connected
-           so the only thing to do is switch out letters for other letters.
-           If we are sampling without replacement and there are no letters
-           left to swap in from the pool, there is nothing left to do. */
-        return std::accumulate(best.begin(), best.end(), std::string(""));
+    size_t best = 0;
+    for (size_t k = 1; k < replicas.size(); ++k) {
+        if (replicas[k]->best_energy < replicas[best]->best_energy) {
+            best = k;
+        }
+    }
+    size_t best_energy = replicas[best]->best_energy;
+    if (schedule.trace) {
+        trace_best(start, 0, replicas[best]->best_score);
     }
 
-    do {
-        iterations++;
-        std::vector<std::string> tmp(best);
-        std::vector<std::string> save_pool(pool);
-
-        /* Don't do a die swap if anagram, anagrams are already fully connected */
-        if (is_anagram || ((rand() % 2) && !(ld->sampleWithoutReplacement() && pool.size() == 0))) {
-            /* Change one of the letters */
-            int i = rand() % num_letters;
-            if (ld->sampleWithoutReplacement()) {
-                // Swap with a remaining pool letter
-                int j = rand() % pool.size();
-                std::swap(tmp[i], pool[j]);
+    ThreadPool *pool = s.get_thread_pool();
+    size_t iterations = 0;
+    for (size_t round = 0, stale = 0; best_energy > 0 && stale < schedule.patience; ++round) {
+        if (pool && replicas.size() > 1) {
+            // The pool may be shared with other boards or clients, so only
+            // this round's steps are waited for
+            std::atomic<size_t> remaining(ladder.size());
+            std::mutex done_lock;
+            std::condition_variable done;
+
+            for (size_t k = 0; k < ladder.size(); ++k) {
+                pool->submit([&, k](size_t) {
+                    ladder[k]->step(grs, temperatures[k], schedule.steps);
+
+                    if (--remaining == 0) {
+                        std::unique_lock<std::mutex> guard(done_lock);
+                        done.notify_one();
+                    }
+                });
             }
-            else {
-                int j = rand() % prop_letters.size();
-                tmp[i] = prop_letters[j];
+
+            std::unique_lock<std::mutex> guard(done_lock);
+            while (remaining > 0) {
+                done.wait(guard);
             }
-        } 
+        }
         else {
-            // Swap die
-            int i = rand() % num_letters;
-            int j = rand() % num_letters;
-            std::swap(tmp[i], tmp[j]);
+            for (size_t k = 0; k < ladder.size(); ++k) {
+                ladder[k]->step(grs, temperatures[k], schedule.steps);
+            }
         }
 
-        std::string tmp_board = std::accumulate(tmp.begin(), tmp.end(), std::string(""));
-        Board b(tmp_board, grs.grid);
-        s.solve(&b, *grs.scoring_rules);
-        Solver::SolutionList solutions = s.get_solutions();
-        sort(solutions.begin(), solutions.end());
-        solutions.erase(unique(solutions.begin(), solutions.end(), equal_words), solutions.end());
-
-        size_t board_score = solutions.size();
-        size_t board_points = 0;    
-
-        for(Solver::SolutionList::iterator i = solutions.begin(); i != solutions.end(); ++i) {
-            board_points += i->get_score();
+        iterations = 0;
+        size_t round_best = best;
+        for (size_t k = 0; k < replicas.size(); ++k) {
+            iterations += replicas[k]->iterations;
+            if (replicas[k]->best_energy < replicas[round_best]->best_energy) {
+                round_best = k;
+            }
         }
 
-        if (
-            (reverse_target && ((board_score < best_score || board_points < best_points) or 
-             ( (int)(board_score - best_score) < (250 / (changes) ) ))) ||
-            (!reverse_target && ((board_score > best_score || board_points > best_points) or 
-             ( (int)(best_score - board_score) < (250 / (changes) ) )))
-            ) 
-        {
-            best = tmp;
-            best_score = board_score;
-            best_points = board_points;
-            duds = 0;
-            changes++;
+        if (replicas[round_best]->best_energy < best_energy) {
+            best = round_best;
+            best_energy = replicas[best]->best_energy;
+            stale = 0;
+            if (schedule.trace) {
+                trace_best(start, iterations, replicas[best]->best_score);
+            }
         }
         else {
-            duds++;
-            pool = save_pool;
+            ++stale;
         }
 
-    } while (duds < max_duds and (
-        (!reverse_target && (best_score < min_words || best_points < min_score)) ||
-        (reverse_target && (best_score > min_words || best_points > min_score)) ));
+        // Neighbours swap places on the ladder with the usual Metropolis
+        // chance, alternating between the even and odd pairs each round
+        for (size_t k = round % 2; k + 1 < ladder.size(); k += 2) {
+            double cold = ladder[k]->energy, hot = ladder[k + 1]->energy;
+            double x = (1 / temperatures[k] - 1 / temperatures[k + 1]) * (cold - hot);
+            if (x >= 0 || rng.uniform() < std::exp(x)) {
+                std::swap(ladder[k], ladder[k + 1]);
+            }
+        }
+    }
 
-    return std::accumulate(best.begin(), best.end(), std::string(""));
-} 
+    for (size_t k = 0; k < replicas.size(); ++k) {
+        s.add_stats(replicas[k]->solver.get_stats());
+    }
+    if (totals) {
+        *totals = replicas[best]->best_score;
+    }
+    if (scored) {
+        *scored = iterations;
+    }
+    return replicas[best]->best;
+}
+
+
+bool start_rescoring(const GameRuleSet &grs, Solver &s, const std::string &letters, size_t tiles, Solver::PathSet &paths, Solver::Score *score) {
+    // Each candidate board differs from the best board in one or two tiles,
+    // so only the paths through those need to be searched again.  This
+    // needs a tile for each die or letter, and is of no help when every
+    // tile is adjacent to every other.  If given, score is set to the
+    // score of the board either way.
+    Board b(letters, grs.grid);
+    if (grs.grid->adjacency() == "Full" || tiles > MAX_MASK_TILES ||
+        b.get_board_size() != tiles) {
+        if (score) {
+            *score = s.score(&b, *grs.scoring_rules);
+        }
+        return false;
+    }
+
+    Solver::Score board_score = s.score_paths(&b, *grs.scoring_rules, paths);
+    if (score) {
+        *score = board_score;
+    }
+    return true;
+}
+
+
+Solver::Score score_candidate(const GameRuleSet &grs, Solver &s, const std::string &letters, size_t tiles, uint64_t changed, bool &rescoring, const Solver::PathSet &best_paths, Solver::PathSet &paths) {
+    // A die face or letter that is not a single tile moves the tiles after
+    // it, the rest of the boards are then scored in full
+    Board b(letters, grs.grid);
+    if (rescoring && b.get_board_size() == tiles) {
+        return s.rescore(&b, *grs.scoring_rules, best_paths, changed, paths);
+    }
+
+    rescoring = false;
+    return s.score(&b, *grs.scoring_rules);
+}
@@ -19,10 +19,37 @@
 #define WGS_MAKER_H
 
 #include <string>
+#include "random.h"
 #include "wgs.h"
 #include "scramble.h"
 
-std::string generate_simple_board(const GameRuleSet &grs); 
-std::string generate_board(const GameRuleSet &grs, Solver &s, size_t min_words, size_t min_score, bool reverse_target = false);
+// How boards are generated by parallel tempering.  Several replicas of the
+// board are annealed at once, each at its own temperature, and replicas at
+// neighbouring temperatures exchange boards every round.  The hot replicas
+// wander between very different boards while the cold ones keep improving
+// the best found so far.  Temperatures are in the words and points a board
+// is short of its target.
+class TemperingSchedule {
+public:
+    size_t replicas;            // boards annealed at once, 0 to use the
+                                // single board annealer instead
+    double min_temperature;     // of the coldest replica
+    double max_temperature;     // of the hottest, those between are spaced
+                                // geometrically
+    size_t steps;               // candidates each replica scores in a round
+    size_t patience;            // rounds without a better board to give up
+                                // after
+    bool trace;                 // write each better board found to stderr
+
+    TemperingSchedule() : replicas(0), min_temperature(1), max_temperature(30),
+        steps(10), patience(40), trace(false) {}
+};
+
+std::string generate_simple_board(const GameRuleSet &grs, Random &rng);
+// Generate a board by simulated annealing, see the create command, or by
+// parallel tempering when a schedule with replicas is given.  If given,
+// score is set to the words and points of the board returned and
+// iterations to the number of candidate boards scored.
+std::string generate_board(const GameRuleSet &grs, Solver &s, Random &rng, size_t min_words, size_t min_score, bool reverse_target = false, Solver::Score *score = 0, size_t *iterations = 0, const TemperingSchedule *schedule = 0);
 
 #endif
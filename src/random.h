@@ -0,0 +1,100 @@
+// This file is part of WGS, a customizable Word Game Solver.
+//
+// Copyright 2014 Robert Gamble <rgamble99@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WGS_RANDOM_H
+#define WGS_RANDOM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class Random {
+    // The xoshiro256** generator.  Unlike rand() it has no shared state,
+    // so every thread making boards can have its own, and it gives the
+    // same sequence for a seed on every platform.
+    //
+    // A seed gives a family of independent streams: stream n starts 2^128
+    // values after stream n - 1, further apart than any run will reach.
+public:
+    explicit Random(uint64_t seed, size_t stream = 0) {
+        // The state is filled from the seed with splitmix64, which never
+        // leaves it all zero
+        for (int i = 0; i < 4; ++i) {
+            seed += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            s[i] = z ^ (z >> 31);
+        }
+        for (size_t i = 0; i < stream; ++i) {
+            jump();
+        }
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    // A value from 0 to n - 1, n must not be 0
+    size_t below(size_t n) { return next() % n; }
+
+    // A value from 0 up to but not including 1
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    template <class T> void shuffle(std::vector<T> &v) {
+        for (size_t i = v.size(); i > 1; --i) {
+            std::swap(v[i - 1], v[below(i)]);
+        }
+    }
+
+    // Move to the start of the next stream, equivalent to 2^128 calls to
+    // next()
+    void jump() {
+        static const uint64_t JUMP[] = { 0x180ec6d33cfd0abaULL,
+            0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+        uint64_t t[4] = { 0, 0, 0, 0 };
+        for (int i = 0; i < 4; ++i) {
+            for (int b = 0; b < 64; ++b) {
+                if (JUMP[i] & (uint64_t(1) << b)) {
+                    for (int j = 0; j < 4; ++j) {
+                        t[j] ^= s[j];
+                    }
+                }
+                next();
+            }
+        }
+        for (int j = 0; j < 4; ++j) {
+            s[j] = t[j];
+        }
+    }
+
+private:
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+};
+
+#endif
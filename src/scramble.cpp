@@ -17,199 +17,133 @@
 
 #include <string>
 #include <cctype>
+#include <chrono>
+#include <climits>
 #include <cstring>
 #include <cmath>
 #include <sstream>
 #include <iostream>
+#include <iterator>
 #include "scramble.h"
 
-// Trie function implementations
-const Trie * Trie::child(char c) const {
-    // Assumes uppercase characters have sequential values
-    if (!isupper(c)) return 0;
-    if (children) {
-        return children[c - 'A'];
-    }
-    else if (child_letter) {
-        if (child_letter == c) {
-            return child_ptr;
-        }
-    }
-    return 0;
-}
-
-Trie::Trie() {
-    children = 0;
-    child_ptr = 0;
-    child_letter = '\0';
-    is_word = false;
+Board::Board(std::string _letters, const GameGrid *g):
+    letters(_letters) {
+    parse_board();
+    adjacency = GridAdjacency::get(g, board_size);
 }
 
-Trie::~Trie() {
-    if (child_ptr) {
-        delete child_ptr;
-    }
-    if (children) {
-        for (int i = 0; i < ALPHABET_SIZE; i++) {
-            if (children[i]) delete children[i]; //lint !e1551
-        }
-        delete [] children;
-    }
+Board::~Board() {
+    delete [] tile_grid;
+    delete [] letter_mult_grid;
+    delete [] word_mult_grid;
 }
 
-void Trie::add_word(const char *word) {
-    if (!word) return;
-
-    char letter = std::toupper(*word);
 
-    if (letter == '\0') {
-        // If we reach the end of the string, the current position represents
-        // a full word
-        is_word = true;
-        return;
+std::shared_ptr<const GridAdjacency> GridAdjacency::get(const GameGrid *g, size_t board_size) {
+    if (!g) {
+        return std::make_shared<GridAdjacency>(g, board_size);
     }
 
-    if (!isupper(letter))
-        return;
-
-    int idx = letter - 'A';
-    
-    if (children) {
-        // Already has children array
-        if (!children[idx])
-            children[idx] = new Trie;
+    // Boards on a grid almost always fill it, so only the adjacency for the
+    // most recent board size is kept
+    std::shared_ptr<const GridAdjacency> cached = g->cachedAdjacency();
+    if (!cached || cached->get_board_size() != board_size) {
+        cached = std::make_shared<GridAdjacency>(g, board_size);
+        g->setCachedAdjacency(cached);
+    }
+    return cached;
+}
 
-        children[idx]->add_word(word + 1);
+GridAdjacency::GridAdjacency(const GameGrid *g, size_t _board_size) :
+    board_size(_board_size), full(!g || g->adjacency() == "Full"),
+    grid_rows(0), grid_columns(0) {
+    // Precompute the tiles adjacent to each tile so that the solver only
+    // needs to visit actual neighbors.
+    if (full) {
+        build_full_neighbors();
     }
     else {
-        // No children array
-        if (child_letter == letter) {
-            // Child matches sought letter
-            child_ptr->add_word(word + 1);
-        }
-        else if (!child_letter) {
-            // New Node
-            child_letter = letter;
-            child_ptr = new Trie;
-            child_ptr->add_word(word + 1);
-        }
-        else {
-            // Child node does not match sought letter, convert
-            // to children array
-            children = new Trie *[ALPHABET_SIZE];
-            for (int i = 0; i < ALPHABET_SIZE; i++) {
-                children[i] = 0;
+        build_grid_neighbors(g);
+    }
+
+    if (board_size <= MAX_MASK_TILES) {
+        neighbor_masks.assign(board_size, 0);
+        for (size_t i = 0; i < board_size; ++i) {
+            for (const TilePosition *j = neighbors_begin(i); j != neighbors_end(i); ++j) {
+                neighbor_masks[i] |= uint64_t(1) << *j;
             }
-            children[child_letter - 'A'] = child_ptr;
-            child_ptr = 0;
-            child_letter = '\0';
-            children[idx] = new Trie;
-            children[idx]->add_word(word + 1);
         }
     }
 }
 
-bool Trie::is_a_word(const char *word) const {
-    // lookup a word starting at the root
-    if (!word) return false;
+void GridAdjacency::build_full_neighbors() {
+    neighbor_list.clear();
+    neighbor_index.assign(1, 0);
 
-    char letter = *word;
-
-    if (letter == '\0') {
-        return is_word;
-    }
-
-    if (!isupper(letter))
-        return false;
-
-    int idx = *word - 'A';
-    if (child_letter) {
-        if (child_letter == *word) {
-            return child_ptr->is_a_word(word + 1);
+    for (size_t i = 0; i < board_size; ++i) {
+        for (size_t j = 0; j < board_size; ++j) {
+            if (i != j) {
+                neighbor_list.push_back(j);
+            }
         }
-        return false;
+        neighbor_index.push_back(neighbor_list.size());
     }
-
-    return children[idx] && children[idx]->is_a_word(word + 1);
+    // Keep the list addressable for boards without any adjacent tiles
+    neighbor_list.push_back(0);
 }
 
-
-Board::Board(std::string _letters, const GameGrid *g):
-    letters(_letters), adj_matrix(0) {
-    parse_board();
-    build_adjacency_matrix(g);
-}
-
-Board::~Board() {
-    delete [] tile_grid;
-    delete [] letter_mult_grid;
-    delete [] word_mult_grid;
-    delete [] adj_matrix;
-}
-
-void Board::build_adjacency_matrix(const GameGrid *g) {
-    if (!g || g->adjacency() == "Full") return;
-    
-    int **pos_matrix = new int*[MAX_GRID_WIDTH];
-    for (int i = 0; i < MAX_GRID_WIDTH; ++i) pos_matrix[i] = new int[MAX_GRID_WIDTH];
-
-    size_t pos = 0;
-
-    for (int row = 0; row < MAX_GRID_WIDTH; ++row) {
-        for (int col = 0; col < MAX_GRID_WIDTH; ++col) {
-            if (g->isTileSet(row, col) && pos < board_size) {
-                pos_matrix[row][col] = pos++;
-            }
-            else {
-                pos_matrix[row][col] = -1;
+void GridAdjacency::build_grid_neighbors(const GameGrid *g) {
+    bool diagonal = g->adjacency() == "Diagonal";
+    bool straight = diagonal || g->adjacency() == "Straight";
+    int rows = g->height();
+    int cols = g->width();
+
+    // Number the grid's tiles in order, the tiles past the end of a board
+    // are left out
+    std::vector<int> pos_matrix(rows * cols, -1);
+    std::vector<std::pair<int, int> > tile_cells;
+    for (int row = 0; row < rows; ++row) {
+        for (int col = 0; col < cols; ++col) {
+            if (g->isTileSet(row, col) && tile_cells.size() < board_size) {
+                pos_matrix[row * cols + col] = tile_cells.size();
+                tile_cells.push_back(std::make_pair(row, col));
             }
         }
     }
 
-    adj_matrix = new bool[board_size * board_size];
-    for (size_t i = 0; i < board_size * board_size; ++i) {
-        adj_matrix[i] = false;
-    }
-    
-    for (int row = 0; row < MAX_GRID_WIDTH; ++row) {
-        for (int col = 0; col < MAX_GRID_WIDTH; ++col) {
-            int pos = pos_matrix[row][col];
-            if (pos == -1) continue;
-
-            if (g->adjacency() == "Diagonal") {
-                if (row > 0 && col > 0 && pos_matrix[row-1][col-1] != -1) {
-                    adj_matrix[pos * board_size + pos_matrix[row-1][col-1]] = true;
-                }
-                if (row > 0 && col < MAX_GRID_WIDTH - 1 && pos_matrix[row-1][col+1] != -1) {
-                    adj_matrix[pos * board_size + pos_matrix[row-1][col+1]] = true;
-                }
-                if (row < MAX_GRID_WIDTH - 1 && col > 0 && pos_matrix[row+1][col-1] != -1) {
-                    adj_matrix[pos * board_size + pos_matrix[row+1][col-1]] = true;
-                }
-                if (row < MAX_GRID_WIDTH - 1 && col < MAX_GRID_WIDTH - 1 && pos_matrix[row+1][col+1] != -1) {
-                    adj_matrix[pos * board_size + pos_matrix[row+1][col+1]] = true;
-                }
-            }
-
-            if (g->adjacency() == "Diagonal" || g->adjacency() == "Straight") {
-                if (row > 0 && pos_matrix[row-1][col] != -1) {
-                    adj_matrix[pos * board_size + pos_matrix[row-1][col]] = true;
-                }
-                if (row < MAX_GRID_WIDTH - 1 && pos_matrix[row+1][col] != -1) {
-                    adj_matrix[pos * board_size + pos_matrix[row+1][col]] = true;
-                }
-                if (col > 0 && pos_matrix[row][col-1] != -1) {
-                    adj_matrix[pos * board_size + pos_matrix[row][col-1]] = true;
-                }
-                if (col < MAX_GRID_WIDTH - 1 && pos_matrix[row][col+1] != -1) {
-                    adj_matrix[pos * board_size + pos_matrix[row][col+1]] = true;
+    neighbor_list.clear();
+    neighbor_index.assign(1, 0);
+
+    for (size_t i = 0; i < board_size; ++i) {
+        // Tiles beyond the grid have no neighbors
+        if (i < tile_cells.size()) {
+            int row = tile_cells[i].first;
+            int col = tile_cells[i].second;
+            size_t first = neighbor_list.size();
+
+            for (int dr = -1; dr <= 1; ++dr) {
+                for (int dc = -1; dc <= 1; ++dc) {
+                    if (dr == 0 && dc == 0) continue;
+                    if (dr != 0 && dc != 0 ? !diagonal : !straight) continue;
+                    int r = row + dr;
+                    int c = col + dc;
+                    if (r < 0 || r >= rows || c < 0 || c >= cols) continue;
+                    if (pos_matrix[r * cols + c] != -1) {
+                        neighbor_list.push_back(pos_matrix[r * cols + c]);
+                    }
                 }
             }
+            std::sort(neighbor_list.begin() + first, neighbor_list.end());
         }
+        neighbor_index.push_back(neighbor_list.size());
     }
+    // Keep the list addressable for boards without any adjacent tiles
+    neighbor_list.push_back(0);
 
-    for (int i = 0; i < MAX_GRID_WIDTH; ++i) delete [] pos_matrix[i];
-    delete [] pos_matrix;
+    if (diagonal && board_size == tile_cells.size() && board_size == size_t(rows * cols)) {
+        grid_rows = rows;
+        grid_columns = cols;
+    }
 }
 
 void Board::parse_board() {
@@ -260,82 +194,86 @@ void Board::parse_board() {
 }
 
 
-Solution::Solution(std::string _word, const unsigned char * start_pos,
-    const unsigned char * stop_pos, unsigned _word_length, unsigned _score,
-    unsigned _letter_points, unsigned _word_multiplier, double _length_bonus):
-    word(_word), word_length(_word_length), score(_score),
-    letter_points(_letter_points), word_multiplier(_word_multiplier),
-    length_bonus(_length_bonus)  {
+Solution::Solution(const Dictionary *_dict, uint32_t _word_id,
+    const TilePosition * start_pos, const TilePosition * stop_pos,
+    unsigned _word_length, unsigned _score, unsigned _letter_points,
+    unsigned _word_multiplier, double _length_bonus):
+    dict(_dict), length_bonus(_length_bonus), word_id(_word_id),
+    word_length(_word_length), score(_score), letter_points(_letter_points),
+    word_multiplier(_word_multiplier)  {
 
     num_positions = stop_pos - start_pos;  //lint !e732
-    positions = new unsigned char[num_positions];
-
-    for (size_t i = 0; i < num_positions; i++) {
-        positions[i] = start_pos[i];
-    }
+    copy_positions(start_pos);
 }
 
-Solution::Solution(const Solution &s) {
-    num_positions = s.num_positions;
-    score = s.score;
-    letter_points = s.letter_points;
-    word_multiplier = s.word_multiplier;
-    length_bonus = s.length_bonus;
-    word_length = s.word_length;
-    word = s.word;
-
-    positions = new unsigned char[num_positions];
-    std::memcpy(positions, s.positions, num_positions);
+Solution::Solution(const Solution &s) :
+    dict(s.dict), length_bonus(s.length_bonus), word_id(s.word_id),
+    word_length(s.word_length), score(s.score),
+    letter_points(s.letter_points), word_multiplier(s.word_multiplier),
+    num_positions(s.num_positions) {
+    copy_positions(s.get_positions());
 }
 
 Solution::Solution(Solution &&s) :
-    word(std::move(s.word)) {
-    num_positions = s.num_positions;
-    score = s.score;
-    letter_points = s.letter_points;
-    word_multiplier = s.word_multiplier;
-    length_bonus = s.length_bonus;
-    word_length = s.word_length;
-    positions=s.positions;
-    s.positions = 0;
+    dict(s.dict), length_bonus(s.length_bonus), word_id(s.word_id),
+    word_length(s.word_length), score(s.score),
+    letter_points(s.letter_points), word_multiplier(s.word_multiplier),
+    num_positions(s.num_positions) {
+    if (num_positions > INLINE_POSITIONS) {
+        long_positions = s.long_positions;
+        s.num_positions = 0;
+    }
+    else {
+        std::memcpy(short_positions, s.short_positions, num_positions * sizeof(TilePosition));
+    }
 }
 
 Solution& Solution::operator=(const Solution &s) {
     if (this == &s) return *this;
 
-    num_positions = s.num_positions;
-    score = s.score;
-    letter_points = s.letter_points;
-    word_multiplier = s.word_multiplier;
-    length_bonus = s.length_bonus;
-    word_length = s.word_length;
-    word = std::move(s.word);
-
-    delete [] positions;
-    positions = new unsigned char[num_positions];
-    std::memcpy(positions, s.positions, num_positions);
-    return *this;
+    Solution tmp(s);
+    return *this = std::move(tmp);
 }
 
 Solution& Solution::operator=(Solution &&s) {
     if (this == &s) return *this;
 
-    num_positions = s.num_positions;
+    if (num_positions > INLINE_POSITIONS) {
+        delete [] long_positions;
+    }
+
+    dict = s.dict;
+    word_id = s.word_id;
     score = s.score;
     letter_points = s.letter_points;
     word_multiplier = s.word_multiplier;
     length_bonus = s.length_bonus;
     word_length = s.word_length;
-    word = s.word;
+    num_positions = s.num_positions;
 
-    delete [] positions;
-    positions = s.positions;
-    s.positions = 0;
+    if (num_positions > INLINE_POSITIONS) {
+        long_positions = s.long_positions;
+        s.num_positions = 0;
+    }
+    else {
+        std::memcpy(short_positions, s.short_positions, num_positions * sizeof(TilePosition));
+    }
     return *this;
 }
 
 Solution::~Solution() {
-    delete [] positions;
+    if (num_positions > INLINE_POSITIONS) {
+        delete [] long_positions;
+    }
+}
+
+void Solution::copy_positions(const TilePosition *start_pos) {
+    // Expects num_positions to be set
+    TilePosition *positions = short_positions;
+    if (num_positions > INLINE_POSITIONS) {
+        positions = long_positions = new TilePosition[num_positions];
+    }
+    std::memcpy(positions, start_pos, num_positions * sizeof(TilePosition));
 }
 
 std::string Solution::format(const std::string &fmt, bool expand_paren) const {
@@ -346,7 +284,7 @@ std::string Solution::format(const std::string &fmt, bool expand_paren) const {
             char fmt_specifier = *i;
             switch (fmt_specifier) {
                 case 'w':
-                    result << word;
+                    result << get_word();
                     break;
                 case 's':
                     result << score;
@@ -373,7 +311,7 @@ std::string Solution::format(const std::string &fmt, bool expand_paren) const {
                             if (pos > 0) {
                                 result << separator;
                             }
-                            result << positions[pos] + 1 /* 0-base to 1-base */;
+                            result << get_positions()[pos] + 1 /* 0-base to 1-base */;
                         }
                     }
                     break;
@@ -437,163 +375,695 @@ std::string Solution::format(const std::string &fmt, bool expand_paren) const {
 }
 
 
-void Solver::add_word(const char *word) {
-    dict.add_word(word);
+void Solver::solve(const Board *b, const GameScoringRules &sr, bool best_only) {
+    if (!b) return;
+
+    solutions.clear();
+    if (b->get_board_size() > MAX_BOARD_TILES) return;
+    board = b;
+    use_rules(sr);
+    search(best_only ? BEST_PATHS : ALL_PATHS);
+    if (COLLECT_STATS) {
+        count_words(best_only ? BEST_PATHS : ALL_PATHS);
+    }
+}
+
+Solver::Score Solver::score(const Board *b, const GameScoringRules &sr) {
+    Score result = { 0, 0 };
+    if (!b || b->get_board_size() > MAX_BOARD_TILES) return result;
+
+    solutions.clear();
+    board = b;
+    use_rules(sr);
+    search(SCORE_ONLY);
+
+    // Combine the words found by each worker, keeping the best score
+    SearchState &total = states[0];
+    for (size_t i = 1; i < states.size(); i++) {
+        const SearchState &st = states[i];
+        for (size_t j = 0; j < st.found.size(); j++) {
+            total.add_word(st.found[j], st.best[st.found[j]]);
+        }
+    }
+
+    result.words = total.found.size();
+    for (size_t i = 0; i < total.found.size(); i++) {
+        result.points += total.best[total.found[i]];
+    }
+    if (COLLECT_STATS) {
+        stats.words += result.words;
+    }
+    return result;
 }
 
-void Solver::solve(const Board *b, const GameScoringRules &sr) {
-    if (!b) return;
+Solver::Score Solver::score_paths(const Board *b, const GameScoringRules &sr, PathSet &paths) {
+    paths.paths.clear();
+    if (!b || b->get_board_size() > MAX_MASK_TILES) {
+        Score result = { 0, 0 };
+        return result;
+    }
+
+    uint64_t all_tiles = ~uint64_t(0) >> (MAX_MASK_TILES - b->get_board_size());
+    return track_paths(b, sr, all_tiles, paths);
+}
+
+Solver::Score Solver::rescore(const Board *b, const GameScoringRules &sr, const PathSet &previous, uint64_t changed, PathSet &paths) {
+    paths.paths.clear();
+    if (!b || b->get_board_size() > MAX_MASK_TILES) {
+        Score result = { 0, 0 };
+        return result;
+    }
+
+    // Paths that avoid the changed tiles spell the same words for the same
+    // score as before.  They are counted with the paths searched so that
+    // every path on the board is in the paths statistic.
+    for (size_t i = 0; i < previous.paths.size(); i++) {
+        if (!(previous.paths[i].tiles & changed)) {
+            paths.paths.push_back(previous.paths[i]);
+        }
+    }
+    if (COLLECT_STATS) {
+        stats.paths += paths.paths.size();
+    }
+    return track_paths(b, sr, changed, paths);
+}
 
+Solver::Score Solver::track_paths(const Board *b, const GameScoringRules &sr, uint64_t changed, PathSet &paths) {
+    // Adds the paths through the changed tiles to paths and totals them
     solutions.clear();
-    cur_len = 0;
     board = b;
-    
+    use_rules(sr);
+    changed_tiles = changed;
+    find_changed_distances();
+    search(TRACK_PATHS);
+
+    for (size_t i = 0; i < states.size(); i++) {
+        paths.paths.insert(paths.paths.end(), states[i].tracked.begin(), states[i].tracked.end());
+        states[i].tracked.clear();
+    }
+
+    SearchState &st = states[0];
+    st.reset_words(dict->word_count());
+    for (size_t i = 0; i < paths.paths.size(); i++) {
+        st.add_word(paths.paths[i].word_id, paths.paths[i].score);
+    }
+
+    Score result = { st.found.size(), 0 };
+    for (size_t i = 0; i < st.found.size(); i++) {
+        result.points += st.best[st.found[i]];
+    }
+    if (COLLECT_STATS) {
+        stats.words += result.words;
+    }
+    return result;
+}
+
+void Solver::find_changed_distances() {
+    // A breadth first search out from the changed tiles, tiles that can
+    // not reach one keep the largest distance
+    changed_distance.assign(board->get_board_size(), UCHAR_MAX);
+    uint64_t frontier = changed_tiles;
+    uint64_t seen = changed_tiles;
+    for (unsigned char distance = 0; frontier; distance++) {
+        uint64_t next = 0;
+        for (; frontier; frontier &= frontier - 1) {
+            size_t i = ctz64(frontier);
+            changed_distance[i] = distance;
+            next |= board->neighbor_mask(i);
+        }
+        frontier = next & ~seen;
+        seen |= frontier;
+    }
+}
+
+void Solver::use_rules(const GameScoringRules &sr) {
+    if (rules != &sr) {
+        scoring = ScoringTable(sr);
+        rules = &sr;
+    }
+}
+
+void Solver::search(SearchMode mode) {
+    auto start = std::chrono::steady_clock::now();
+
+    find_missing_letters();
+    if (pool && pool->size() > 1 && board->get_board_size() > 1) {
+        search_parallel(mode);
+    }
+    else {
+        search_serial(mode);
+    }
+
+    if (COLLECT_STATS) {
+        for (size_t i = 0; i < states.size(); i++) {
+            stats += states[i].stats;
+            states[i].stats = SearchStats();
+        }
+        stats.searches++;
+        stats.search_us += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+void Solver::search_serial(SearchMode mode) {
     size_t board_size = board->get_board_size();
-    delete [] used;
-    delete [] path;
-    delete [] wildcard;
-    used = new unsigned char[board_size];
-    path = new unsigned char[board_size];
-    wildcard = new char[board_size];
+    states.resize(1);
+    SearchState &st = states[0];
+    st.reset(board_size);
+    st.solutions = &solutions;
+    st.mode = mode;
+    if (mode != ALL_PATHS) {
+        st.reset_words(dict->word_count());
+    }
 
+    SearchKernel kernel = select_kernel(mode);
+    st.candidates = first_identical;
+    PathTotals start = { 0, 0, 1, 0 };
     for (size_t i = 0; i < board_size; i++) {
-        path[i] = 0;
-        used[i] = 0;
-        wildcard[i] = '\0';
+        (this->*kernel)(st, i, dict->root(), 0, start);
     }
+}
+
+void Solver::search_parallel(SearchMode mode) {
+    // Each starting tile is searched by a separate task using the scratch
+    // space of the worker it runs on, into a solution list of its own.
+    // The lists are joined in tile order once every task has finished.
+    // When keeping the best paths each list holds the best paths from its
+    // own tile and the duplicates between lists are removed afterwards.
+    size_t board_size = board->get_board_size();
+
+    states.resize(pool->size());
+    for (size_t i = 0; i < states.size(); i++) {
+        states[i].reset(board_size);
+        states[i].mode = mode;
+        if (mode != ALL_PATHS) {
+            states[i].reset_words(dict->word_count());
+        }
+    }
+
+    root_solutions.resize(board_size);
+    for (size_t i = 0; i < board_size; i++) {
+        root_solutions[i].clear();
+    }
+
+    SearchKernel kernel = select_kernel(mode);
+    for (size_t i = 0; i < states.size(); i++) {
+        states[i].candidates = first_identical;
+    }
+
+    PathTotals start = { 0, 0, 1, 0 };
+    std::atomic<size_t> remaining(board_size);
+    std::mutex done_lock;
+    std::condition_variable done;
 
     for (size_t i = 0; i < board_size; i++) {
-        _solve(i, &dict, board->tile(i), sr);
+        pool->submit([&, i](size_t worker) {
+            SearchState &st = states[worker];
+            st.solutions = &root_solutions[i];
+            if (mode == BEST_PATHS) {
+                st.reset_words(dict->word_count());
+            }
+            (this->*kernel)(st, i, dict->root(), 0, start);
+
+            if (--remaining == 0) {
+                std::unique_lock<std::mutex> guard(done_lock);
+                done.notify_one();
+            }
+        });
     }
+
+    {
+        std::unique_lock<std::mutex> guard(done_lock);
+        while (remaining > 0) {
+            done.wait(guard);
+        }
+    }
+
+    for (size_t i = 0; i < board_size; i++) {
+        solutions.insert(solutions.end(),
+            std::make_move_iterator(root_solutions[i].begin()),
+            std::make_move_iterator(root_solutions[i].end()));
+    }
+
+    if (mode == BEST_PATHS) {
+        keep_best_paths();
+    }
+}
+
+void Solver::count_words(SearchMode mode) {
+    // Solutions only hold one path for each word when keeping the best
+    if (mode == BEST_PATHS) {
+        stats.words += solutions.size();
+        return;
+    }
+
+    SearchState &st = states[0];
+    st.reset_words(dict->word_count());
+    for (size_t i = 0; i < solutions.size(); i++) {
+        uint32_t id = solutions[i].get_word_id();
+        if (st.stamp[id] != st.generation) {
+            st.stamp[id] = st.generation;
+            stats.words++;
+        }
+    }
+}
+
+void Solver::keep_best_paths() {
+    // Remove all but the first highest scoring solution for each word,
+    // keeping the order in which the words were first found
+    SearchState &st = states[0];
+    st.reset_words(dict->word_count());
+
+    size_t kept = 0;
+    for (size_t i = 0; i < solutions.size(); i++) {
+        uint32_t id = solutions[i].get_word_id();
+        if (st.stamp[id] != st.generation) {
+            st.stamp[id] = st.generation;
+            st.slot[id] = kept;
+            if (kept != i) {
+                solutions[kept] = std::move(solutions[i]);
+            }
+            kept++;
+        }
+        else if (solutions[i].get_score() > solutions[st.slot[id]].get_score()) {
+            solutions[st.slot[id]] = std::move(solutions[i]);
+        }
+    }
+    solutions.erase(solutions.begin() + kept, solutions.end());
+}
+
+// The search kernels are templates on a Shape class that describes the
+// board.  GenericShape looks everything up at run time and works on any
+// board.  DiagonalGrid fixes the neighbors and the Q rule at compile time
+// for a board that fills a rectangular grid with Diagonal adjacency.
+// AnagramShape is for boards where every tile is adjacent to every other,
+// so a word can use the tiles in any order.  Identical tiles are then
+// interchangeable and only the first unused tile of each group of
+// identical tiles is tried, which finds each distinct way of spelling a
+// word once instead of once for every ordering of the identical tiles.
+struct GenericShape {
+    static const bool anagram = false;
+    static bool q_is_qu(const ScoringTable &rules)
+        { return rules.q_is_qu(); }
+    static bool masked(const Board &b)
+        { return b.get_board_size() <= MAX_MASK_TILES; }
+    static uint64_t neighbors(const Board &b, size_t pos)
+        { return b.neighbor_mask(pos); }
+};
+
+constexpr uint64_t grid_cell(int rows, int cols, int row, int col) {
+    return (row >= 0 && row < rows && col >= 0 && col < cols) ?
+        uint64_t(1) << (row * cols + col) : 0;
+}
+
+constexpr uint64_t diagonal_neighbors(int rows, int cols, int row, int col) {
+    return grid_cell(rows, cols, row - 1, col - 1) | grid_cell(rows, cols, row - 1, col) |
+        grid_cell(rows, cols, row - 1, col + 1) | grid_cell(rows, cols, row, col - 1) |
+        grid_cell(rows, cols, row, col + 1) | grid_cell(rows, cols, row + 1, col - 1) |
+        grid_cell(rows, cols, row + 1, col) | grid_cell(rows, cols, row + 1, col + 1);
 }
 
-void Solver::_solve(size_t pos, const Trie *t, const std::string &tile, const GameScoringRules &sr) {
-    if (!t) return;
+template <size_t... I> struct IndexList {};
+template <size_t N, size_t... I> struct MakeIndexList : MakeIndexList<N - 1, N - 1, I...> {};
+template <size_t... I> struct MakeIndexList<0, I...> { typedef IndexList<I...> type; };
+
+template <int Rows, int Cols, class Indices = typename MakeIndexList<Rows * Cols>::type>
+struct DiagonalNeighbors;
+
+template <int Rows, int Cols, size_t... I>
+struct DiagonalNeighbors<Rows, Cols, IndexList<I...> > {
+    static constexpr uint64_t masks[sizeof...(I)] = {
+        diagonal_neighbors(Rows, Cols, int(I) / Cols, int(I) % Cols)...
+    };
+};
+
+template <int Rows, int Cols, size_t... I>
+constexpr uint64_t DiagonalNeighbors<Rows, Cols, IndexList<I...> >::masks[sizeof...(I)];
+
+struct AnagramShape {
+    static const bool anagram = true;
+    static bool q_is_qu(const ScoringTable &rules)
+        { return rules.q_is_qu(); }
+    static bool masked(const Board &)
+        { return true; }
+    static uint64_t neighbors(const Board &b, size_t pos)
+        { return b.neighbor_mask(pos); }
+};
+
+template <int Rows, int Cols, bool QIsQu>
+struct DiagonalGrid {
+    static_assert(Rows * Cols <= int(MAX_MASK_TILES), "grid too large for a mask");
+    static const bool anagram = false;
+
+    static bool q_is_qu(const ScoringTable &)
+        { return QIsQu; }
+    static bool masked(const Board &)
+        { return true; }
+    static uint64_t neighbors(const Board &, size_t pos)
+        { return DiagonalNeighbors<Rows, Cols>::masks[pos]; }
+};
+
+template <class Shape>
+void Solver::_solve(SearchState &st, size_t pos, const DictNode *t, uint32_t word_id, PathTotals totals) {
+    // Add the tile at pos to the current path
+    const std::string &tile = board->tile(pos);
     if (tile.empty()) return;
 
-    for (std::string::const_iterator i = tile.begin(); i != tile.end(); ++i) {
-        if (*i == '?') {
-            for (int i = 0; i < ALPHABET_SIZE; ++i) {
-                wildcard[pos] = 'A' + i;
-                std::string new_tile_value(1, 'A'+i);
-                new_tile_value.append(tile.substr(1));
-                _solve(pos, t, new_tile_value, sr);
+    // A tile identical to an unused tile before it would only repeat the
+    // paths through that tile
+    if (Shape::anagram && !((st.candidates >> pos) & 1)) return;
+
+    totals.tile_points = 0;
+    follow_tile<Shape>(st, pos, t, word_id, tile.c_str(), totals);
+}
+
+template <class Shape>
+void Solver::follow_tile(SearchState &st, size_t pos, const DictNode *t, uint32_t word_id, const char *letters, PathTotals totals) {
+    // Descend the dictionary through the remaining letters of a tile
+    for (; *letters; ++letters) {
+        char letter = std::toupper(*letters);
+
+        if (letter == '?') {
+            // Only try the letters that continue a word from here
+            uint32_t children = t->child_letters();
+            for (unsigned n = 0; children; ++n, children &= children - 1) {
+                const DictNode *child = t->nth_child(n);
+                uint32_t child_id = word_id + t->words_before(n);
+                char wildcard = 'A' + ctz64(children);
+                st.wildcard[pos] = wildcard;
+                if (COLLECT_STATS) st.stats.wildcards++;
+
+                // if Q, descend to u
+                if (Shape::q_is_qu(scoring) && wildcard == 'Q') {
+                    child = child->child('U', child_id);
+                    if (!child) {
+                        if (COLLECT_STATS) st.stats.dead_ends++;
+                        continue;
+                    }
+                }
+
+                PathTotals child_totals = totals;
+                child_totals.tile_points += scoring.wildcard_value(wildcard);
+                child_totals.word_length += scoring.letter_length(wildcard);
+                follow_tile<Shape>(st, pos, child, child_id, letters + 1, child_totals);
             }
             return;
         }
 
-        t = t->child(std::toupper(*i));
-        if (!t) return;
+        t = t->child(letter, word_id);
 
         // if Q, descend to u
-        if (sr.qIsQu() && std::toupper(*i) == 'Q') {
-            t = t->child('U');
-            if (!t) return;
+        if (t && Shape::q_is_qu(scoring) && letter == 'Q') {
+            t = t->child('U', word_id);
         }
+
+        if (!t) {
+            if (COLLECT_STATS) st.stats.dead_ends++;
+            return;
+        }
+
+        totals.tile_points += scoring.letter_value(letter);
+        totals.word_length += scoring.letter_length(letter);
     }
 
-    used[pos] = 1;
-    path[cur_len++] = pos;
+    extend<Shape>(st, pos, t, word_id, totals);
+}
 
-    if (t->is_a_word()) {
-        // Score solution
-        Solution new_solution = score_solution(*board, sr, path, path + cur_len);
-        if (int(new_solution.get_word_length()) >= sr.minWordLength()) {
-            solutions.emplace_back(new_solution);
+template <class Shape>
+void Solver::extend(SearchState &st, size_t pos, const DictNode *t, uint32_t word_id, PathTotals totals) {
+    // The tile at pos has been matched, record any word it completes and
+    // continue the path through the unused neighbors.
+    st.path[st.cur_len++] = pos;
+    totals.letter_points += totals.tile_points * board->letter_mult(pos);
+    totals.word_multiplier *= board->word_mult(pos);
+    if (COLLECT_STATS) st.stats.nodes++;
+
+    if (t->is_a_word() && int(totals.word_length) >= scoring.min_word_length()) {
+        if (COLLECT_STATS && st.mode != TRACK_PATHS) st.stats.paths++;
+        WordScore ps = scoring.score_word(totals.word_length, totals.letter_points, totals.word_multiplier);
+
+        if (st.mode == SCORE_ONLY) {
+            st.add_word(word_id, ps.score);
+        }
+        else if (st.mode == TRACK_PATHS) {
+            uint64_t tiles = st.used_mask | (uint64_t(1) << pos);
+            if (tiles & changed_tiles) {
+                PathSet::Path path = { tiles, word_id, ps.score };
+                st.tracked.push_back(path);
+                if (COLLECT_STATS) st.stats.paths++;
+            }
+        }
+        else if (st.mode == BEST_PATHS) {
+            // Only build a solution for a new word or a better path
+            bool is_new = st.stamp[word_id] != st.generation;
+            if (is_new || ps.score > (*st.solutions)[st.slot[word_id]].get_score()) {
+                Solution new_solution(dict, word_id, &st.path[0], &st.path[0] + st.cur_len,
+                    ps.word_length, ps.score, ps.letter_points, ps.word_multiplier, ps.length_bonus);
+                if (is_new) {
+                    st.stamp[word_id] = st.generation;
+                    st.slot[word_id] = st.solutions->size();
+                    st.solutions->emplace_back(std::move(new_solution));
+                }
+                else {
+                    (*st.solutions)[st.slot[word_id]] = std::move(new_solution);
+                }
+            }
+        }
+        else {
+            st.solutions->emplace_back(dict, word_id, &st.path[0], &st.path[0] + st.cur_len,
+                ps.word_length, ps.score, ps.letter_points, ps.word_multiplier, ps.length_bonus);
         }
     }
 
-    size_t board_size = board->get_board_size();
-    for (size_t i = 0; i < board_size; i++) {
-        if (!used[i] && board->is_adjacent(pos, i)) {
-            _solve(i, t, board->tile(i), sr);
+    if (t->required_letters() & missing_letters) {
+        // Every word below needs a letter the board does not have
+        if (COLLECT_STATS) st.stats.pruned++;
+        --st.cur_len;
+        return;
+    }
+
+    if (st.mode == TRACK_PATHS && changed_distance[pos] > t->max_depth() &&
+            !((st.used_mask | (uint64_t(1) << pos)) & changed_tiles)) {
+        // No word below is long enough to reach a changed tile
+        if (COLLECT_STATS) st.stats.pruned++;
+        --st.cur_len;
+        return;
+    }
+
+    if (Shape::anagram) {
+        // Visit only the first unused tile of each group of identical tiles
+        uint64_t candidates = st.candidates;
+        st.candidates = (candidates & ~(uint64_t(1) << pos)) | next_identical[pos];
+        for (uint64_t next = st.candidates; next; next &= next - 1) {
+            size_t i = ctz64(next);
+            _solve<Shape>(st, i, t, word_id, totals);
+        }
+        st.candidates = candidates;
+    }
+    else if (Shape::masked(*board)) {
+        // Visit only the unused neighbors
+        uint64_t bit = uint64_t(1) << pos;
+        st.used_mask |= bit;
+        for (uint64_t next = Shape::neighbors(*board, pos) & ~st.used_mask; next; next &= next - 1) {
+            size_t i = ctz64(next);
+            _solve<Shape>(st, i, t, word_id, totals);
+        }
+        st.used_mask &= ~bit;
+    }
+    else {
+        // Larger boards mark the used tiles in a wider bitset
+        uint64_t bit = uint64_t(1) << (pos % 64);
+        st.used[pos / 64] |= bit;
+        for (const TilePosition *i = board->neighbors_begin(pos); i != board->neighbors_end(pos); ++i) {
+            if (!((st.used[*i / 64] >> (*i % 64)) & 1)) {
+                _solve<Shape>(st, *i, t, word_id, totals);
+            }
         }
+        st.used[pos / 64] &= ~bit;
     }
 
-    used[pos] = 0;
-    --cur_len;
+    --st.cur_len;
 }
 
+Solver::SearchKernel Solver::select_kernel(SearchMode mode) {
+    const GridAdjacency &adjacency = board->get_adjacency();
 
-Solution Solver::score_solution(const Board &b, const GameScoringRules &s, const unsigned char *start_pos, const unsigned char *stop_pos) const {
-    int word_len = 0;
-    unsigned score = 0;
-    unsigned letter_points = 0;
-    unsigned word_multiplier = 1;
-    double length_bonus = 0;
-    std::string word = "";
-
-    const unsigned char *iter = start_pos;
+    // Every path is wanted when listing or tracking all paths,
+    // interchangeable tiles included
+    if ((mode == BEST_PATHS || mode == SCORE_ONLY) && adjacency.all_adjacent() &&
+            board->get_board_size() <= MAX_MASK_TILES) {
+        group_identical_tiles();
+        return &Solver::_solve<AnagramShape>;
+    }
 
-    while (iter != stop_pos) {
-        unsigned tile_value = 0;
+    size_t rows = adjacency.diagonal_grid_rows();
+    size_t cols = adjacency.diagonal_grid_columns();
 
-        const std::string &tile_letters = b.tile(*iter);
-        for (auto i = tile_letters.begin(); i != tile_letters.end(); ++i) {
-            bool is_wildcard = false;
-            char letter = *i;
+    if (rows == 4 && cols == 4) return diagonal_grid_kernel<4, 4>();
+    if (rows == 5 && cols == 5) return diagonal_grid_kernel<5, 5>();
+    if (rows == 6 && cols == 6) return diagonal_grid_kernel<6, 6>();
+    return &Solver::_solve<GenericShape>;
+}
 
+void Solver::find_missing_letters() {
+    // A wildcard can stand for any letter
+    uint32_t available = 0;
+    for (size_t i = 0; i < board->get_board_size(); i++) {
+        const std::string &tile = board->tile(i);
+        for (auto c = tile.begin(); c != tile.end(); ++c) {
+            char letter = std::toupper(*c);
             if (letter == '?') {
-                letter = wildcard[*iter];
-                is_wildcard = true;
+                available = DictNode::LETTER_MASK;
             }
-
-            word_len++;
-            word += std::toupper(letter);
-
-            if ((letter == 'Q' || letter == 'q') && s.qIsQu()) {
-                word += 'U';
-                if (s.quLength() == 2) {
-                    word_len++;
+            else if (std::isupper(letter)) {
+                available |= 1u << (letter - 'A');
+                if (letter == 'Q' && scoring.q_is_qu()) {
+                    available |= 1u << ('U' - 'A');
                 }
             }
+        }
+    }
+    missing_letters = ~available & DictNode::LETTER_MASK;
+}
+
+void Solver::group_identical_tiles() {
+    // Tiles are identical when they have the same letters and multipliers
+    size_t board_size = board->get_board_size();
+    next_identical.assign(board_size, 0);
+    first_identical = 0;
 
-            if (!is_wildcard || s.wildCardPoints()) {
-                tile_value += s.letterValue(letter);
+    for (size_t i = 0; i < board_size; i++) {
+        size_t j = 0;
+        for (; j < i; j++) {
+            if (board->tile(j) == board->tile(i) &&
+                    board->letter_mult(j) == board->letter_mult(i) &&
+                    board->word_mult(j) == board->word_mult(i)) {
+                break;
             }
         }
 
-        unsigned letter_multiplier = b.letter_mult(*iter);
+        if (j == i) {
+            first_identical |= uint64_t(1) << i;
+            continue;
+        }
+
+        // Link i after the last tile in the group
+        while (next_identical[j]) {
+            j = ctz64(next_identical[j]);
+        }
+        next_identical[j] = uint64_t(1) << i;
+    }
+}
+
+template <int Rows, int Cols>
+Solver::SearchKernel Solver::diagonal_grid_kernel() const {
+    if (scoring.q_is_qu()) {
+        return &Solver::_solve<DiagonalGrid<Rows, Cols, true> >;
+    }
+    return &Solver::_solve<DiagonalGrid<Rows, Cols, false> >;
+}
+
+SearchStats & SearchStats::operator+=(const SearchStats &s) {
+    searches += s.searches;
+    nodes += s.nodes;
+    dead_ends += s.dead_ends;
+    pruned += s.pruned;
+    wildcards += s.wildcards;
+    paths += s.paths;
+    words += s.words;
+    search_us += s.search_us;
+    return *this;
+}
+
+void SearchStats::print(std::ostream &out) const {
+    if (!COLLECT_STATS) {
+        out << "Solver stats: not collected in this build" << std::endl;
+        return;
+    }
+
+    out << "Solver stats:" << "\n"
+        << "searches=" << searches << "\n"
+        << "nodes=" << nodes << "\n"
+        << "dead_ends=" << dead_ends << "\n"
+        << "pruned=" << pruned << "\n"
+        << "wildcards=" << wildcards << "\n"
+        << "paths=" << paths << "\n"
+        << "words=" << words << "\n"
+        << "duplicates=" << paths - words << "\n"
+        << "search_us=" << search_us << std::endl;
+}
 
-        letter_points += tile_value * letter_multiplier;
-        word_multiplier *= b.word_mult(*iter);
-        iter++;
+ScoringTable::ScoringTable() :
+    length_bonuses(), expand_q(false), min_length(0), short_length(0),
+    short_points(0), short_multiplier(false), round_up(false),
+    multiply_bonus(false) {
+    std::fill(letter_values, letter_values + 256, 0);
+    std::fill(wildcard_values, wildcard_values + 256, 0);
+    std::fill(letter_lengths, letter_lengths + 256, 1);
+}
+
+ScoringTable::ScoringTable(const GameScoringRules &sr) :
+    length_bonuses(), expand_q(sr.qIsQu()), min_length(sr.minWordLength()),
+    short_length(sr.shortWordLength()), short_points(sr.shortWordPoints()),
+    short_multiplier(sr.shortWordMultiplier()), round_up(sr.roundBonusUp()),
+    multiply_bonus(sr.multiplyLengthBonus()) {
+    for (int c = 0; c < 256; ++c) {
+        letter_values[c] = sr.letterValue(c);
+        wildcard_values[c] = sr.wildCardPoints() ? letter_values[c] : 0;
+        letter_lengths[c] = 1;
     }
 
-    if (word_len < s.minWordLength()) {
-        return Solution(word, start_pos, stop_pos, word_len, 0, 0, 1, 0);
+    // The U following a Q may count towards the length of a word
+    if (sr.qIsQu() && sr.quLength() == 2) {
+        letter_lengths['Q'] = letter_lengths['q'] = 2;
     }
 
-    if (word_len <= s.shortWordLength()) {
-        if (s.shortWordMultiplier()) {
-            return Solution(word, start_pos, stop_pos, word_len,
-                word_multiplier * s.shortWordPoints(), s.shortWordPoints(),
-                word_multiplier, 0);
+    for (auto i = sr.length_bonuses.begin(); i != sr.length_bonuses.end(); ++i) {
+        if (i->first < 0) continue;
+        if ((size_t) i->first >= length_bonuses.size()) {
+            length_bonuses.resize(i->first + 1, 0);
         }
-        else {
-            return Solution(word, start_pos, stop_pos, word_len,
-                s.shortWordPoints(), s.shortWordPoints(), 1, 0);
+        length_bonuses[i->first] = i->second;
+    }
+}
+
+WordScore ScoringTable::score_word(unsigned word_length, unsigned letter_points, unsigned word_multiplier) const {
+    WordScore ws = { word_length, 0, 0, 1, 0 };
+
+    if (int(word_length) < min_length) {
+        return ws;
+    }
+
+    if (int(word_length) <= short_length) {
+        ws.score = ws.letter_points = short_points;
+        if (short_multiplier) {
+            ws.score = word_multiplier * short_points;
+            ws.word_multiplier = word_multiplier;
         }
+        return ws;
+    }
+
+    ws.letter_points = letter_points;
+    ws.word_multiplier = word_multiplier;
+    if (word_length < length_bonuses.size()) {
+        ws.length_bonus = length_bonuses[word_length];
     }
 
-    length_bonus = s.lengthBonus(word_len);
-    if (s.multiplyLengthBonus()) {
-        if (s.roundBonusUp()) {
-            score = ceil(letter_points * word_multiplier * length_bonus);
+    if (multiply_bonus) {
+        if (round_up) {
+            ws.score = ceil(letter_points * word_multiplier * ws.length_bonus);
         }
         else {
-            score = (letter_points * word_multiplier * length_bonus);
+            ws.score = (letter_points * word_multiplier * ws.length_bonus);
         }
     }
     else {
-        if (s.roundBonusUp()) {
-            score = ceil(letter_points * word_multiplier + length_bonus);
+        if (round_up) {
+            ws.score = ceil(letter_points * word_multiplier + ws.length_bonus);
         }
         else {
-            score = letter_points * word_multiplier + length_bonus;
+            ws.score = letter_points * word_multiplier + ws.length_bonus;
         }
     }
-
-    return Solution(word, start_pos, stop_pos, word_len, score, letter_points,
-        word_multiplier, length_bonus);
+    return ws;
 }
@@ -22,28 +22,81 @@
 #include <cstring>
 #include <algorithm>
 #include <map>
+#include <iosfwd>
+#include <memory>
 #include <string>
+#include <vector>
+#include "dictionary.h"
+#include "thread_pool.h"
 #include "wgs.h"
 
 //lint -sem(Board::parse_board,initializer)
 
 const int ALPHABET_SIZE = 26;
 
-class Trie {
+// Boards with at most this many tiles track tiles with 64-bit masks
+const size_t MAX_MASK_TILES = 64;
+
+// The position of a tile on a board, in the order the tiles are given
+typedef uint16_t TilePosition;
+const size_t MAX_BOARD_TILES = 65536;
+
+inline unsigned ctz64(uint64_t x) {
+#ifdef __GNUC__
+    return __builtin_ctzll(x);
+#else
+    unsigned n = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+class GridAdjacency {
+    // The tiles adjacent to each tile of a board, which depend only on the
+    // grid and the number of tiles on the board.  Built once per grid and
+    // shared by every board on it.
 public:
-    Trie();
-    ~Trie();
-    void add_word(const char *word);
-    const Trie * find_word(const char *word) const;
-    bool is_a_word(const char *word) const;
-    bool is_a_word() const { return is_word; }
-    const Trie * child(char) const;
+    GridAdjacency(const GameGrid *g, size_t board_size);
+
+    // The adjacency for boards with board_size tiles on grid g, taken from
+    // the grid's cache when possible
+    static std::shared_ptr<const GridAdjacency> get(const GameGrid *g, size_t board_size);
+
+    size_t get_board_size() const
+        { return board_size; }
+    bool is_adjacent(size_t i, size_t j) const
+        { return full || std::binary_search(neighbors_begin(i), neighbors_end(i), j); }
+    uint64_t neighbor_mask(size_t i) const
+        { return neighbor_masks[i]; }
+    const TilePosition *neighbors_begin(size_t i) const
+        { return &neighbor_list[0] + neighbor_index[i]; }
+    const TilePosition *neighbors_end(size_t i) const
+        { return &neighbor_list[0] + neighbor_index[i + 1]; }
+
+    // The size of the grid when the board fills every position of a
+    // rectangular grid with Diagonal adjacency, otherwise 0
+    size_t diagonal_grid_rows() const
+        { return grid_rows; }
+    size_t diagonal_grid_columns() const
+        { return grid_columns; }
+
+    // Every tile is adjacent to every other tile
+    bool all_adjacent() const
+        { return full; }
 
 private:
-    Trie *child_ptr;
-    Trie **children;
-    char child_letter;
-    bool is_word;
+    size_t board_size;
+    bool full;                              // every tile is adjacent
+    size_t grid_rows;
+    size_t grid_columns;
+    std::vector<uint64_t> neighbor_masks;   // only up to MAX_MASK_TILES
+    std::vector<TilePosition> neighbor_list;  // sorted for each tile
+    std::vector<size_t> neighbor_index;
+    void build_grid_neighbors(const GameGrid *g);
+    void build_full_neighbors();
 };
 
 
@@ -61,90 +114,359 @@ public:
     size_t get_board_size() const
         { return board_size; }
     bool is_adjacent(size_t i, size_t j) const
-        { return (adj_matrix ? adj_matrix[i * board_size + j] : true); }
+        { return adjacency->is_adjacent(i, j); }
     const std::string & get_letters() const
         { return letters; }
 
+    // Tiles adjacent to tile i as a bit mask, only for boards with no more
+    // than MAX_MASK_TILES tiles
+    uint64_t neighbor_mask(size_t i) const
+        { return adjacency->neighbor_mask(i); }
+
+    // Tiles adjacent to tile i as a list of positions
+    const TilePosition *neighbors_begin(size_t i) const
+        { return adjacency->neighbors_begin(i); }
+    const TilePosition *neighbors_end(size_t i) const
+        { return adjacency->neighbors_end(i); }
+
+    const GridAdjacency & get_adjacency() const
+        { return *adjacency; }
+
 private:
     std::string letters;
-    bool *adj_matrix;
+    std::shared_ptr<const GridAdjacency> adjacency;
     std::string *tile_grid;
     unsigned char *letter_mult_grid;
     unsigned char *word_mult_grid;
     size_t board_size;
     void parse_board();
-    void build_adjacency_matrix(const GameGrid *g);
     Board(const Board &b);
     Board& operator=(const Board &);
 };
 
 
+// The scoring of one word
+struct WordScore {
+    unsigned word_length;
+    unsigned score;
+    unsigned letter_points;
+    unsigned word_multiplier;
+    double length_bonus;
+};
+
+class ScoringTable {
+    // GameScoringRules compiled into flat tables for use while solving.
+    // The letter tables are indexed by character, so upper and lower case
+    // letters need no conversion.
+public:
+    ScoringTable();
+    explicit ScoringTable(const GameScoringRules &sr);
+
+    // Points for a letter on a tile and for a letter chosen for a wildcard
+    int letter_value(char letter) const
+        { return letter_values[(unsigned char) letter]; }
+    int wildcard_value(char letter) const
+        { return wildcard_values[(unsigned char) letter]; }
+
+    // The number of letters a tile letter adds to the length of a word
+    unsigned letter_length(char letter) const
+        { return letter_lengths[(unsigned char) letter]; }
+
+    bool q_is_qu() const { return expand_q; }
+    int min_word_length() const { return min_length; }
+
+    // The score of a word from its total letter points and multiplier
+    WordScore score_word(unsigned word_length, unsigned letter_points, unsigned word_multiplier) const;
+
+private:
+    int letter_values[256];
+    int wildcard_values[256];
+    unsigned char letter_lengths[256];
+    std::vector<double> length_bonuses;     // by word length
+    bool expand_q;
+    int min_length;
+    int short_length;
+    unsigned short_points;
+    bool short_multiplier;
+    bool round_up;
+    bool multiply_bonus;
+};
+
+
 class Solution {
+    // A word found on a board.  Only the path and the word's ID are kept,
+    // the text of the word is looked up in the dictionary when it is asked
+    // for, so a Solution must not outlive the dictionary it came from.
 public:
-    Solution(std::string word, const unsigned char * start_pos, const unsigned char * stop_pos, unsigned word_length, unsigned score, unsigned letter_points, unsigned word_multiplier, double length_bonus);
+    Solution(const Dictionary *dict, uint32_t word_id, const TilePosition * start_pos, const TilePosition * stop_pos, unsigned word_length, unsigned score, unsigned letter_points, unsigned word_multiplier, double length_bonus);
     Solution(const Solution &s);
     Solution(Solution &&s);
     Solution& operator=(const Solution &s);
     Solution& operator=(Solution &&s);
     ~Solution();
-    const std::string & get_word() const { return word; }
+    std::string get_word() const { return dict->word(word_id); }
+    uint32_t get_word_id() const { return word_id; }
     unsigned get_score() const { return score; }
-    const unsigned char * get_positions() const { return positions; }
+    const TilePosition * get_positions() const
+        { return num_positions > INLINE_POSITIONS ? long_positions : short_positions; }
     size_t get_num_positions() const { return num_positions; }
     unsigned get_word_length() const { return word_length; }
     std::string format(const std::string &fmt, bool expand_paren = true) const;
-    const unsigned char *positions_begin() const { return positions; }
-    const unsigned char *positions_end() const { return positions + num_positions; }
+    const TilePosition *positions_begin() const { return get_positions(); }
+    const TilePosition *positions_end() const { return get_positions() + num_positions; }
     unsigned int letterPoints() const { return letter_points; }
     unsigned int wordMultiplier() const { return word_multiplier; }
     double lengthBonus() const { return length_bonus; }
 
 private:
-    std::string word;
+    // Paths up to this length are stored without a separate allocation,
+    // which keeps a Solution to 64 bytes
+    static const size_t INLINE_POSITIONS = 12;
+
+    const Dictionary *dict;
+    double length_bonus;
+    uint32_t word_id;
     unsigned int word_length;
-    unsigned char *positions;
-    size_t num_positions;
     unsigned int score;
     unsigned int letter_points;
     unsigned int word_multiplier;
-    double length_bonus;
+    uint32_t num_positions;
+    union {
+        TilePosition short_positions[INLINE_POSITIONS];
+        TilePosition *long_positions;
+    };
+
+    void copy_positions(const TilePosition *start_pos);
 };
 
 
+// Solutions from the same dictionary compare by word ID, which follows
+// alphabetical order
 inline bool equal_words(const Solution &a, const Solution &b) {
-    return a.get_word() == b.get_word();
+    return a.get_word_id() == b.get_word_id();
 }
 
 inline bool operator<(const Solution &a, const Solution &b) {
-    if (a.get_word() < b.get_word()) {
-        return true;
-    }
-    else if (a.get_word() > b.get_word()) {
-        return false;
+    if (a.get_word_id() != b.get_word_id()) {
+        return a.get_word_id() < b.get_word_id();
     }
     return a.get_score() > b.get_score();
 }
 
+// Define WGS_NO_STATS to build the search without its counters
+#ifdef WGS_NO_STATS
+const bool COLLECT_STATS = false;
+#else
+const bool COLLECT_STATS = true;
+#endif
+
+// Counts of the work done by a Solver, summed over every search it makes
+struct SearchStats {
+    uint64_t searches;      // boards searched
+    uint64_t nodes;         // tiles matched to a dictionary node
+    uint64_t dead_ends;     // tiles that continue no word in the dictionary
+    uint64_t pruned;        // paths ended as every word needs a missing letter
+    uint64_t wildcards;     // letters tried in place of a wildcard
+    uint64_t paths;         // paths that spell a word
+    uint64_t words;         // distinct words found on each board
+    uint64_t search_us;     // microseconds spent searching
+
+    SearchStats() : searches(0), nodes(0), dead_ends(0), pruned(0),
+        wildcards(0), paths(0), words(0), search_us(0) {}
+    SearchStats & operator+=(const SearchStats &s);
+
+    // Writes one key=value line for each count, the keys do not change
+    // between releases
+    void print(std::ostream &out) const;
+};
+
 class Solver {
 public:
     typedef std::multimap<std::string, Solution> SolutionMap;
     typedef std::vector<Solution> SolutionList;
-    Solver(): board(0), used(0), path(0), cur_len(0), wildcard(0) {};
-    ~Solver() { delete [] used; delete [] path; delete [] wildcard; board = 0; }
-    void add_word(const char *word);
-    void solve(const Board *b, const GameScoringRules &sr);
+    Solver(const Dictionary &d): dict(&d), board(0), pool(0), rules(0),
+        first_identical(0), missing_letters(0), changed_tiles(0) {};
+    // Find every path on the board that spells a word.  With best_only set
+    // only the highest scoring path for each word is kept, the first one
+    // found when several score the same.  Boards with more than
+    // MAX_BOARD_TILES tiles have no solutions.
+    void solve(const Board *b, const GameScoringRules &sr, bool best_only = false);
     const SolutionList & get_solutions() const { return solutions; }
-    Solution score_solution(const Board &b, const GameScoringRules &sr, const unsigned char *begin, const unsigned char *end) const;
+
+    // The number of distinct words on a board and the sum of the best
+    // score found for each.  This gives the same totals as solving,
+    // removing duplicate words and adding up the scores, without building
+    // any solutions.
+    struct Score {
+        size_t words;
+        size_t points;
+    };
+    Score score(const Board *b, const GameScoringRules &sr);
+
+    // Every path spelling a word on a board, as found by score_paths()
+    class PathSet {
+    public:
+        struct Path {
+            uint64_t tiles;     // the tiles on the path as a mask
+            uint32_t word_id;
+            unsigned score;
+        };
+
+        size_t size() const { return paths.size(); }
+        void swap(PathSet &other) { paths.swap(other.paths); }
+
+    private:
+        friend class Solver;
+        std::vector<Path> paths;
+    };
+
+    // Scores a board like score() and also keeps each path found in paths,
+    // so that the board can be rescored after a change to a few tiles.
+    // Boards with more than MAX_MASK_TILES tiles have no paths and a score
+    // of zero.
+    Score score_paths(const Board *b, const GameScoringRules &sr, PathSet &paths);
+
+    // Scores a board that differs from the one previous was found on only
+    // in the tiles of the changed mask, setting paths to its paths.  The
+    // paths through the changed tiles are dropped and only paths through
+    // those tiles are searched.
+    Score rescore(const Board *b, const GameScoringRules &sr, const PathSet &previous, uint64_t changed, PathSet &paths);
+
+    // When a pool is set, the search from each starting tile of a board
+    // runs as a separate task on the pool.  The results are the same as
+    // a serial search, in the same order.
+    void set_thread_pool(ThreadPool *p) { pool = p; }
+    ThreadPool * get_thread_pool() const { return pool; }
+
+    const Dictionary & get_dictionary() const { return *dict; }
+
+    // Always zero when built with WGS_NO_STATS
+    const SearchStats & get_stats() const { return stats; }
+
+    // Adds in the counts of another solver, such as one of those create
+    // uses for each replica when tempering
+    void add_stats(const SearchStats &s) { stats += s; }
 
 private:
-    Trie dict;
+    enum SearchMode { ALL_PATHS, BEST_PATHS, SCORE_ONLY, TRACK_PATHS };
+
+    // Running totals for the tiles on the current path, carried down the
+    // search so a word can be scored without walking its path again
+    struct PathTotals {
+        unsigned word_length;
+        unsigned letter_points;     // of the completed tiles
+        unsigned word_multiplier;
+        unsigned tile_points;       // of the letters matched on this tile
+    };
+
+    // Scratch space for one depth-first search
+    struct SearchState {
+        std::vector<uint64_t> used;         // tiles on the path as a bitset,
+        std::vector<TilePosition> path;     // or in used_mask for boards up
+        std::vector<char> wildcard;         // to MAX_MASK_TILES tiles
+        uint64_t used_mask;
+        uint64_t candidates;    // tiles to try next in an anagram search
+        size_t cur_len;
+        SolutionList *solutions;
+
+        // Words found in BEST_PATHS and SCORE_ONLY modes, indexed by word
+        // ID.  A word has been seen in this search when its stamp equals
+        // generation.  best holds the word's best score and slot the index
+        // of its solution when keeping the best paths.
+        SearchMode mode;
+        std::vector<uint32_t> stamp;
+        std::vector<unsigned> best;
+        std::vector<uint32_t> slot;
+        std::vector<uint32_t> found;
+        uint32_t generation;
+
+        // Paths through changed tiles found in TRACK_PATHS mode
+        std::vector<PathSet::Path> tracked;
+
+        SearchStats stats;
+
+        SearchState() : used_mask(0), candidates(0), cur_len(0), solutions(0),
+            mode(ALL_PATHS), generation(0) {}
+
+        void reset(size_t board_size) {
+            used.assign((board_size + 63) / 64, 0);
+            path.assign(board_size, 0);
+            wildcard.assign(board_size, '\0');
+            used_mask = 0;
+            cur_len = 0;
+        }
+
+        void reset_words(size_t word_count) {
+            if (stamp.size() != word_count || ++generation == 0) {
+                stamp.assign(word_count, 0);
+                best.resize(word_count);
+                slot.resize(word_count);
+                generation = 1;
+            }
+            found.clear();
+        }
+
+        void add_word(uint32_t id, unsigned score) {
+            if (stamp[id] != generation) {
+                stamp[id] = generation;
+                best[id] = score;
+                found.push_back(id);
+            }
+            else if (score > best[id]) {
+                best[id] = score;
+            }
+        }
+    };
+
+
+    const Dictionary *dict;
     SolutionList solutions;
     const Board *board;
-    unsigned char *used;
-    unsigned char *path;
-    size_t cur_len;
-    char *wildcard;
-    void _solve(size_t pos, const Trie *t, const std::string &l, const GameScoringRules &sr);
+    ThreadPool *pool;
+
+    // Compiled from rules, which are assumed not to change while in use
+    const GameScoringRules *rules;
+    ScoringTable scoring;
+
+    std::vector<SearchState> states;            // one per pool worker
+
+    // Groups of identical tiles for an anagram search, the first tile of
+    // each group and for each tile the next tile in its group, as masks
+    uint64_t first_identical;
+    std::vector<uint64_t> next_identical;
+
+    // Letters on none of the board's tiles, no path is followed into a
+    // part of the dictionary where every word needs one of them
+    uint32_t missing_letters;
+
+    // Tiles changed since the last search in TRACK_PATHS mode, and for
+    // each tile the fewest steps to one of them.  Only paths through a
+    // changed tile are followed.
+    uint64_t changed_tiles;
+    std::vector<unsigned char> changed_distance;
+
+    std::vector<SolutionList> root_solutions;   // one per starting tile
+    SearchStats stats;
+    void use_rules(const GameScoringRules &sr);
+    void search(SearchMode mode);
+    void search_serial(SearchMode mode);
+    void search_parallel(SearchMode mode);
+    void count_words(SearchMode mode);
+    Score track_paths(const Board *b, const GameScoringRules &sr, uint64_t changed, PathSet &paths);
+    void find_changed_distances();
+    void keep_best_paths();
+
+    // The search is compiled separately for the common board shapes, see
+    // the Shape classes in scramble.cpp, and the kernel for the board is
+    // chosen before each search
+    typedef void (Solver::*SearchKernel)(SearchState &st, size_t pos, const DictNode *t, uint32_t word_id, PathTotals totals);
+    SearchKernel select_kernel(SearchMode mode);
+    void group_identical_tiles();
+    void find_missing_letters();
+    template <int Rows, int Cols> SearchKernel diagonal_grid_kernel() const;
+    template <class Shape> void _solve(SearchState &st, size_t pos, const DictNode *t, uint32_t word_id, PathTotals totals);
+    template <class Shape> void follow_tile(SearchState &st, size_t pos, const DictNode *t, uint32_t word_id, const char *letters, PathTotals totals);
+    template <class Shape> void extend(SearchState &st, size_t pos, const DictNode *t, uint32_t word_id, PathTotals totals);
 };
 
 
@@ -0,0 +1,495 @@
+// This file is part of WGS, a customizable Word Game Solver.
+//
+// Copyright 2014 Robert Gamble <rgamble99@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "maker.h"
+#include "server.h"
+#include "validate.h"
+
+// Requests longer than this are rejected and the client disconnected
+static const size_t MAX_REQUEST_LENGTH = 1 << 20;
+
+// Written to by the signal handler to wake up the accept loop
+static int stop_pipe[2] = { -1, -1 };
+
+static void stop_handler(int) {
+    char c = 0;
+    if (write(stop_pipe[1], &c, 1) < 0) {
+        // Nothing can be done about it here
+    }
+}
+
+
+class Server::Connection {
+public:
+    Connection(int _fd, const Random &_rng) :
+        fd(_fd), buffer(), at_line_start(true), write_failed(false), rng(_rng) {}
+
+    bool failed() const { return write_failed; }
+
+    // Reads the next request line, returns false at end of input
+    bool read_line(std::string &line);
+
+    // A reply is either error() alone or ok(), any number of calls to
+    // write() and then end()
+    bool error(const std::string &message);
+    bool ok();
+    bool write(const std::string &text);
+    bool end();
+
+    Solver & solver(const Dictionary &dict, ThreadPool *search_pool);
+    Random & random() { return rng; }
+
+private:
+    int fd;
+    std::string buffer;
+    bool at_line_start;
+    bool write_failed;
+    std::map<const Dictionary *, std::unique_ptr<Solver> > solvers;
+    Random rng;
+
+    bool send_text(const std::string &text);
+};
+
+bool Server::Connection::read_line(std::string &line) {
+    for (;;) {
+        size_t end = buffer.find('\n');
+        if (end != std::string::npos) {
+            line.assign(buffer, 0, end);
+            buffer.erase(0, end + 1);
+            if (!line.empty() && line[line.size() - 1] == '\r') {
+                line.erase(line.size() - 1);
+            }
+            return true;
+        }
+
+        if (buffer.size() > MAX_REQUEST_LENGTH) {
+            error("Request too long");
+            return false;
+        }
+
+        char data[4096];
+        ssize_t n = recv(fd, data, sizeof(data), 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            // A final request without a newline is still answered
+            if (n == 0 && !buffer.empty()) {
+                line.swap(buffer);
+                buffer.clear();
+                return true;
+            }
+            return false;
+        }
+        buffer.append(data, n);
+    }
+}
+
+bool Server::Connection::send_text(const std::string &text) {
+    const char *data = text.data();
+    size_t remaining = text.size();
+
+    while (remaining > 0 && !write_failed) {
+        ssize_t n = send(fd, data, remaining, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            write_failed = true;
+            break;
+        }
+        data += n;
+        remaining -= n;
+    }
+    return !write_failed;
+}
+
+bool Server::Connection::error(const std::string &message) {
+    // Messages are kept to a single line
+    std::string reply = "ERROR " + message;
+    for (std::string::iterator i = reply.begin(); i != reply.end(); ++i) {
+        if (*i == '\n' || *i == '\r') *i = ' ';
+    }
+    return send_text(reply + "\n");
+}
+
+bool Server::Connection::ok() {
+    at_line_start = true;
+    return send_text("OK\n");
+}
+
+bool Server::Connection::write(const std::string &text) {
+    // Double any period starting a line so that it cannot be mistaken for
+    // the end of the reply
+    std::string stuffed;
+    stuffed.reserve(text.size());
+    for (std::string::const_iterator i = text.begin(); i != text.end(); ++i) {
+        if (at_line_start && *i == '.') {
+            stuffed += '.';
+        }
+        stuffed += *i;
+        at_line_start = (*i == '\n');
+    }
+    return send_text(stuffed);
+}
+
+bool Server::Connection::end() {
+    std::string text = at_line_start ? ".\n" : "\n.\n";
+    at_line_start = true;
+    return send_text(text);
+}
+
+Solver & Server::Connection::solver(const Dictionary &dict, ThreadPool *search_pool) {
+    std::unique_ptr<Solver> &s = solvers[&dict];
+    if (!s) {
+        s.reset(new Solver(dict));
+        s->set_thread_pool(search_pool);
+    }
+    return *s;
+}
+
+
+Server::Server(GameConfig &_config, const CommandOptions &_opts) :
+    config(_config), opts(_opts), rng(opts.seed) {
+    // Creating a GameRuleSet fills in parts of the configuration, so they
+    // are all created now, before any client threads are running.
+    for (auto i = config.game_rules.begin(); i != config.game_rules.end(); ++i) {
+        rule_sets[i->first].reset(new GameRuleSet(config, i->first));
+    }
+
+    if (opts.search_threads > 1) {
+        search_pool.reset(new ThreadPool(opts.search_threads));
+    }
+}
+
+Server::~Server() {
+}
+
+const Dictionary * Server::dictionary(const GameDictionary &gd) {
+    // Loading happens with the lock held, other clients needing a
+    // dictionary wait for it to finish
+    std::unique_lock<std::mutex> guard(dictionaries_lock);
+
+    std::pair<std::string, std::string> key(gd.dictFileName(), gd.structure());
+    std::unique_ptr<Dictionary> &dict = dictionaries[key];
+    if (!dict) {
+        std::unique_ptr<Dictionary> loaded(new Dictionary);
+        if (!load_dictionary(gd, *loaded)) {
+            dictionaries.erase(key);
+            return 0;
+        }
+        dict = std::move(loaded);
+    }
+    return dict.get();
+}
+
+int Server::run(const std::string &socket_path) {
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socket_path.empty() || socket_path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Invalid socket path '" << socket_path << "'" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::strcpy(addr.sun_path, socket_path.c_str());
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd == -1) {
+        std::cerr << "Failed to create socket: " << std::strerror(errno) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Replace a socket left behind by a previous server, but nothing else
+    struct stat st;
+    if (lstat(socket_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(socket_path.c_str());
+    }
+
+    if (bind(listen_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        listen(listen_fd, SOMAXCONN) != 0) {
+        std::cerr << "Failed to listen on '" << socket_path << "': "
+            << std::strerror(errno) << std::endl;
+        close(listen_fd);
+        return EXIT_FAILURE;
+    }
+
+    if (pipe(stop_pipe) != 0) {
+        std::cerr << "Failed to create pipe: " << std::strerror(errno) << std::endl;
+        close(listen_fd);
+        unlink(socket_path.c_str());
+        return EXIT_FAILURE;
+    }
+
+    struct sigaction action, old_int, old_term;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = stop_handler;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, &old_int);
+    sigaction(SIGTERM, &action, &old_term);
+
+    std::cerr << "Serving on '" << socket_path << "' with " << opts.jobs
+        << " threads" << std::endl;
+
+    {
+        ThreadPool pool(opts.jobs);
+
+        for (;;) {
+            struct pollfd fds[2];
+            fds[0].fd = listen_fd;
+            fds[0].events = POLLIN;
+            fds[1].fd = stop_pipe[0];
+            fds[1].events = POLLIN;
+
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "poll failed: " << std::strerror(errno) << std::endl;
+                break;
+            }
+            if (fds[1].revents) {
+                break;
+            }
+            if (!fds[0].revents) {
+                continue;
+            }
+
+            int fd = accept(listen_fd, 0, 0);
+            if (fd == -1) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                std::cerr << "accept failed: " << std::strerror(errno) << std::endl;
+                break;
+            }
+
+            {
+                // Each client generates boards from its own stream, in the
+                // order the clients are accepted
+                std::unique_lock<std::mutex> guard(clients_lock);
+                clients.insert(fd);
+                Random client_rng(rng);
+                rng.jump();
+                pool.submit([this, fd, client_rng](size_t) { serve_client(fd, client_rng); });
+            }
+        }
+
+        // Stop accepting new clients and end the connections of the
+        // current ones once their request in progress has been answered
+        close(listen_fd);
+        unlink(socket_path.c_str());
+        {
+            std::unique_lock<std::mutex> guard(clients_lock);
+            for (std::set<int>::iterator i = clients.begin(); i != clients.end(); ++i) {
+                shutdown(*i, SHUT_RD);
+            }
+        }
+        pool.wait();
+    }
+
+    sigaction(SIGINT, &old_int, 0);
+    sigaction(SIGTERM, &old_term, 0);
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    stop_pipe[0] = stop_pipe[1] = -1;
+    return EXIT_SUCCESS;
+}
+
+void Server::serve_client(int fd, const Random &client_rng) {
+    {
+        Connection c(fd, client_rng);
+        std::string line;
+        Request request;
+
+        while (c.read_line(line)) {
+            if (!parse_request(line, request)) {
+                c.error("Unterminated quote");
+                continue;
+            }
+            if (request.empty()) {
+                continue;
+            }
+            if (request[0] == "quit" || !handle_request(c, request)) {
+                break;
+            }
+        }
+    }
+
+    std::unique_lock<std::mutex> guard(clients_lock);
+    clients.erase(fd);
+    close(fd);
+}
+
+bool Server::parse_request(const std::string &line, Request &request) {
+    // Split a request into whitespace separated fields.  Double quotes
+    // group text including spaces into one field.  Inside quotes \" and
+    // \\ stand for a quote and a backslash, any other backslash is kept
+    // so that formats such as "%w %s\n" arrive as they were written.
+    request.clear();
+    size_t i = 0;
+
+    for (;;) {
+        while (i < line.size() && std::isspace(line[i])) {
+            ++i;
+        }
+        if (i == line.size()) {
+            return true;
+        }
+
+        std::string field;
+        while (i < line.size() && !std::isspace(line[i])) {
+            if (line[i] != '"') {
+                field += line[i++];
+                continue;
+            }
+
+            for (++i; i < line.size() && line[i] != '"'; ++i) {
+                if (line[i] == '\\' && i + 1 < line.size() &&
+                    (line[i + 1] == '"' || line[i + 1] == '\\')) {
+                    ++i;
+                }
+                field += line[i];
+            }
+            if (i == line.size()) {
+                return false;
+            }
+            ++i;
+        }
+        request.push_back(field);
+    }
+}
+
+static bool parse_count(const std::string &s, size_t &value) {
+    char *end = 0;
+    value = std::strtoul(s.c_str(), &end, 10);
+    return !s.empty() && *end == '\0';
+}
+
+bool Server::handle_request(Connection &c, const Request &request) {
+    // Returns false once the client can no longer be written to
+    const std::string &command = request[0];
+
+    if (command != "solve" && command != "solve-dups" && command != "score" &&
+        command != "analyze" && command != "check-word" &&
+        command != "check-board" && command != "create") {
+        return c.error("'" + command + "' is not a valid command");
+    }
+
+    if (request.size() < 2) {
+        return c.error("Usage: " + command + " {game-type} ...");
+    }
+
+    auto found = rule_sets.find(request[1]);
+    if (found == rule_sets.end()) {
+        return c.error("'" + request[1] + "' is not a valid game type");
+    }
+    const GameRuleSet &grs = *found->second;
+
+    if (command == "check-word" || command == "check-board") {
+        if (request.size() != 3) {
+            return c.error("Usage: " + command + " {game-type} {word}");
+        }
+        Validator v;
+        bool result = v.validate(grs, request[2], command == "check-word");
+        c.ok();
+        c.write((result ? "+" : "-") + request[2] + " \n");
+        return c.end();
+    }
+
+    size_t boards = 1;
+    size_t min_words = 0;
+    size_t min_score = 0;
+    bool reverse_target = false;
+
+    if (command == "create") {
+        if (request.size() > 6 ||
+            (request.size() > 2 && !parse_count(request[2], boards)) ||
+            (request.size() > 3 && !parse_count(request[3], min_words)) ||
+            (request.size() > 4 && !parse_count(request[4], min_score)) ||
+            (request.size() > 5 && request[5] != "minimize")) {
+            return c.error("Usage: create {game-type} [boards [min-words [min-score [minimize]]]]");
+        }
+        reverse_target = request.size() > 5;
+
+        if (min_words == 0 && min_score == 0 && !reverse_target) {
+            c.ok();
+            for (size_t i = 0; i < boards && !c.failed(); ++i) {
+                c.write(generate_simple_board(grs, c.random()) + "\n");
+            }
+            return c.end();
+        }
+
+        if (grs.letters->generationMethod() == "WordList") {
+            return c.error("Minimum word/score board generation not supported for Word List games");
+        }
+    }
+    else if (command == "solve" || command == "solve-dups" || command == "analyze") {
+        if (request.size() != 3 && request.size() != 4) {
+            return c.error("Usage: " + command + " {game-type} {board} [format]");
+        }
+    }
+    else if (request.size() != 3) {
+        return c.error("Usage: score {game-type} {board}");
+    }
+
+    if (!grs.grid) {
+        return c.error("Game type '" + request[1] + "' has no grid");
+    }
+
+    const Dictionary *dict = dictionary(*grs.dict);
+    if (!dict) {
+        return c.error("Failed to load dictionary '" + grs.dict->dictFileName() + "'");
+    }
+    Solver &s = c.solver(*dict, search_pool.get());
+
+    if (command == "create") {
+        // Boards are sent as they are made
+        c.ok();
+        for (size_t i = 0; i < boards && !c.failed(); ++i) {
+            c.write(create_board(s, grs, c.random(), min_words, min_score, reverse_target, opts.tempering));
+        }
+        return c.end();
+    }
+
+    std::string result;
+    if (command == "solve" || command == "solve-dups") {
+        std::string fmt = request.size() == 4 ? request[3] :
+            grs.preferences->preference("SolutionFormat");
+        std::string solution_prefix = unescape_string(grs.preferences->preference("SolutionPrefix"));
+        std::string solution_suffix = unescape_string(grs.preferences->preference("SolutionSuffix"));
+        bool order_by_score = grs.preferences->preference("SolutionOrder") == "Score";
+        result = solve_board(s, grs, request[2], fmt, command == "solve-dups",
+            order_by_score, solution_prefix, solution_suffix);
+    }
+    else if (command == "analyze") {
+        std::string fmt = request.size() == 4 ? request[3] :
+            grs.preferences->preference("AnalysisFormat");
+        result = analyze_board(s, grs, request[2], fmt, 0);
+    }
+    else {
+        result = score_board(s, grs, request[2]);
+    }
+
+    c.ok();
+    c.write(result);
+    return c.end();
+}
@@ -0,0 +1,77 @@
+// This file is part of WGS, a customizable Word Game Solver.
+//
+// Copyright 2014 Robert Gamble <rgamble99@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WGS_SERVER_H
+#define WGS_SERVER_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "dictionary.h"
+#include "random.h"
+#include "solver.h"
+#include "thread_pool.h"
+#include "wgs.h"
+
+class Server {
+    // Answers requests from clients connected to a Unix domain socket, see
+    // the description of the serve command in solver.cpp for the protocol.
+    //
+    // Every game rule set is resolved when the server starts and is only
+    // read afterwards.  Dictionaries are loaded on first use and kept for
+    // the life of the server, shared between the rule sets and clients
+    // that use them.  Each client connection is handled by a task on the
+    // client pool, with its own Solver for each dictionary it uses.
+public:
+    Server(GameConfig &config, const CommandOptions &opts);
+    ~Server();
+
+    // Serve clients on socket_path until interrupted, returns the exit
+    // status for the program
+    int run(const std::string &socket_path);
+
+private:
+    class Connection;
+    typedef std::vector<std::string> Request;
+
+    GameConfig &config;
+    CommandOptions opts;
+    std::map<std::string, std::unique_ptr<GameRuleSet> > rule_sets;
+
+    // Keyed by file name and structure
+    std::map<std::pair<std::string, std::string>, std::unique_ptr<Dictionary> > dictionaries;
+    std::mutex dictionaries_lock;
+
+    std::unique_ptr<ThreadPool> search_pool;
+    std::set<int> clients;          // open client sockets
+    std::mutex clients_lock;
+    Random rng;                     // copied for each client accepted,
+                                    // then moved on to the next stream
+
+    const Dictionary * dictionary(const GameDictionary &gd);
+    void serve_client(int fd, const Random &client_rng);
+    bool handle_request(Connection &c, const Request &request);
+    static bool parse_request(const std::string &line, Request &request);
+    Server(const Server &);
+    Server& operator=(const Server &);
+};
+
+#endif
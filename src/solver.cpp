@@ -16,20 +16,28 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <set>
 #include <string>
 #include <sstream>
-#include <ctime>
 #include <cstdlib>
 #include "analyze.h"
+#include "bench.h"
 #include "dice.h"
+#include "dictionary.h"
 #include "scramble.h"
 #include "wgs.h"
 #include "wgs_json.h"
 #include "maker.h"
+#include "server.h"
+#include "solver.h"
+#include "thread_pool.h"
 #include "validate.h"
 
 bool cmp_solutions(const Solution &p1, const Solution &p2) {
@@ -41,7 +49,7 @@ bool cmp_solutions(const Solution &p1, const Solution &p2) {
         return false;
     }
     else {
-        return p1.get_word() < p2.get_word();
+        return p1.get_word_id() < p2.get_word_id();
     }
 }
 
@@ -77,24 +85,83 @@ std::string unescape_string(const std::string &s) {
 }
             
 
-void do_score_boards(const GameRuleSet &grs);
-void do_solve_boards(const GameRuleSet &grs, const std::string fmt, bool solve_dups, std::string solution_prefix, std::string solution_suffix);
-void do_generate_simple_boards(const GameRuleSet &grs, size_t boards);
-void do_generate_boards(const GameRuleSet &grs, size_t boards, size_t min_words, size_t min_score, bool reverse_target);
-void do_analyze_boards(const GameRuleSet &grs, const std::string fmt, bool dump_words);
+bool load_dictionary(const GameDictionary &gd, Dictionary &dict) {
+    // Load a dictionary using the structure selected in the configuration
+    return dict.load(gd.dictFileName(), gd.structure() == "DAWG");
+}
+
+
+typedef std::function<std::string(Solver &s, size_t worker, const std::string &line)> BoardHandler;
+
+void process_boards(const Dictionary &dict, const CommandOptions &opts, const BoardHandler &handler);
+void do_score_boards(const GameRuleSet &grs, const CommandOptions &opts);
+void do_solve_boards(const GameRuleSet &grs, const std::string fmt, bool solve_dups, std::string solution_prefix, std::string solution_suffix, const CommandOptions &opts);
+void do_generate_simple_boards(const GameRuleSet &grs, Random &rng, size_t boards);
+void do_generate_boards(const GameRuleSet &grs, size_t boards, size_t min_words, size_t min_score, bool reverse_target, const CommandOptions &opts);
+void do_analyze_boards(const GameRuleSet &grs, const std::string fmt, bool dump_words, const CommandOptions &opts);
 void do_check_words(const GameRuleSet &grs, int verbosity); 
 void do_check_boards(const GameRuleSet &grs, int verbosity); 
+int do_compile_dict(const GameDictionary &gd, const std::string &output_file);
+int do_dict_stats(const GameConfig &config);
 std::string analyze_solutions(const std::string fmt, const Board &b, const Solver::SolutionList &solutions);
 
 const char *config_file = NULL;
 
+static bool parse_thread_count(const char *arg, size_t &count) {
+    // Parse the value of a thread count option, 0 means one per core
+    char *end = NULL;
+    if (arg) {
+        count = std::strtoul(arg, &end, 10);
+    }
+    if (!end || end == arg || *end != '\0') {
+        return false;
+    }
+    if (count == 0) {
+        count = ThreadPool::hardware_threads();
+    }
+    return true;
+}
+
+static bool parse_tempering(const char *arg, TemperingSchedule &schedule) {
+    // Parse replicas[,min-temperature,max-temperature[,steps[,patience]]],
+    // the values not given keep their defaults
+    char *end = NULL;
+    if (!arg) {
+        return false;
+    }
+    schedule.replicas = std::strtoul(arg, &end, 10);
+    if (end == arg || schedule.replicas == 0) {
+        return false;
+    }
+    if (*end == ',') {
+        const char *value = end + 1;
+        schedule.min_temperature = std::strtod(value, &end);
+        if (end == value || *end != ',') {
+            return false;
+        }
+        value = end + 1;
+        schedule.max_temperature = std::strtod(value, &end);
+        if (end == value || !(schedule.min_temperature > 0) ||
+            schedule.max_temperature < schedule.min_temperature) {
+            return false;
+        }
+    }
+    size_t *counts[] = { &schedule.steps, &schedule.patience };
+    for (size_t i = 0; i < 2 && *end == ','; ++i) {
+        const char *value = end + 1;
+        *counts[i] = std::strtoul(value, &end, 10);
+        if (end == value || *counts[i] == 0) {
+            return false;
+        }
+    }
+    return *end == '\0';
+}
+
 int main(int argc, char *argv[]) {
     using std::string;
     using std::cout;
     using std::cerr;
     using std::endl;
-    srand(time(NULL));
-
     // Valid commands:
     //
     // The score, solve, check, and analyze commands operate by reading
@@ -180,9 +247,207 @@ int main(int argc, char *argv[]) {
     //      is maintained and the sum or each word is printed to stderr
     //      along with the number of times each word occurred after all
     //      board have been analyzed, one entry per line.
+    //
+    // serve {socket-path}
+    //      Loads the configuration once and answers requests from any
+    //      number of clients over a Unix domain socket created at
+    //      socket-path, until interrupted.  Dictionaries are loaded when
+    //      first used and shared by every game rule set that names them.
+    //      Clients are served by a pool of threads, one per core unless
+    //      -j is given.
+    //
+    //      Each request is a line of whitespace separated fields, fields
+    //      containing spaces may be enclosed in double quotes.  Inside
+    //      quotes \" stands for a quote and \\ for a backslash, any other
+    //      backslash is passed through unchanged, so a format is written
+    //      as it would be on the command line:
+    //          solve {game-rules} {board} [format]
+    //          solve-dups {game-rules} {board} [format]
+    //          score {game-rules} {board}
+    //          analyze {game-rules} {board} [format]
+    //          check-word {game-rules} {word}
+    //          check-board {game-rules} {board}
+    //          create {game-rules} [boards [min-words [min-points [minimize]]]]
+    //          quit
+    //      The reply is either a single line starting with ERROR and
+    //      describing the problem, or a line containing OK followed by the
+    //      same output the command line would give and a line containing
+    //      a single period.  Output lines starting with a period have
+    //      another period added in front.  The boards from create are sent
+    //      as each one is finished.
+    //      Example:
+    //          score "Super Big Boggle" ABCDEFGHIJKLMNOPQRSTUVWXYZABCDEFGHIJ
+    //          OK
+    //          248 2157
+    //          .
+    //
+    // compile-dict {dictionary} {output-file}
+    //      Builds the named dictionary from the configuration file, using
+    //      its Trie or DAWG structure, and writes it to output-file in a
+    //      compiled binary form.  A compiled
+    //      dictionary is mapped into memory when loaded instead of being
+    //      rebuilt from the word list, which makes startup nearly free.
+    //      A plain word list is still accepted, but is laid out in the
+    //      compiled form on every start: on one core about 20 ms for 60,000
+    //      words and 110 ms for 500,000, against 1 ms once compiled.
+    //      Point the dictionary entry in the configuration file at the
+    //      compiled file to use it; the format is detected automatically.
+    //
+    // dict-stats
+    //      Loads every dictionary in the configuration file and reports
+    //      its memory use as one tab separated line per dictionary: the
+    //      name, the structure, the number of words and nodes, the bytes
+    //      taken by the loaded dictionary, and the bytes of the data it
+    //      was built from: the references to each word and the parts laid
+    //      out for each letter for a Trie, or the graph for a DAWG.
+    //      Compiled files are mapped rather than built and show 0 for the
+    //      last column.
+    //
+    // bench [boards=100 [seed=1 [game-rules...]]]
+    //      Measures the speed of the given games, or of every game in the
+    //      configuration file.  Each game's boards are generated from the
+    //      seed, so a run can be repeated exactly to compare two builds.
+    //      The measurements are loading the dictionary five times, then
+    //      solving, scoring, and analyzing every board, solving every
+    //      board with two tiles replaced by wildcards, creating one board
+    //      for every twenty with as many distinct words as the 90th
+    //      percentile of the boards, by annealing and again by parallel
+    //      tempering with four replicas, and checking every word found
+    //      with check-word.  Boards are solved as by solve, keeping the
+    //      best path for each word.  Each is
+    //      reported as one tab separated line: the game, the measurement,
+    //      the number of samples timed, the number of items processed,
+    //      the total seconds, items per second, and the 50th, 90th and
+    //      99th percentile and maximum time of a sample in microseconds.
+    //      The items are boards, except for create and create-tempering
+    //      where they are the candidate boards scored and check-word where
+    //      they are words.  The -t option applies.
+
+    // Options may appear anywhere on the command line and are removed
+    // before the remaining arguments are processed:
+    //
+    // -j jobs
+    //      Use the given number of worker threads for the score, solve,
+    //      solve-dups, and analyze commands, 0 uses one thread per core.
+    //      For create, the number of boards annealed at once, see also
+    //      --ordered.  For serve, the number of clients answered at once.
+    //      Boards are read in batches and the output for each batch is
+    //      written in input order once the whole batch is done, so this
+    //      is intended for large batches rather than interactive use.
+    //
+    // -t threads
+    //      Search each board with the given number of threads, 0 uses one
+    //      thread per core.  The search from each starting tile is run as
+    //      a separate task, which reduces the time taken to solve a single
+    //      large board.  Applies to the score, solve, solve-dups, analyze,
+    //      create, and bench commands.
+    //
+    // --stats
+    //      Once the boards have been processed, write counts of the work
+    //      done by the solver to standard error, one key=value per line:
+    //      searches    boards searched, including those scored by create
+    //      nodes       tiles matched to a node of the dictionary
+    //      dead_ends   tiles whose letters continue no word
+    //      pruned      paths ended because every word that follows needs
+    //                  a letter that is not on the board
+    //      wildcards   letters tried in place of a wildcard
+    //      paths       paths that spell a word, including those create
+    //                  keeps from the previous board without searching
+    //      words       distinct words, counted separately for each board
+    //      duplicates  paths that spell a word already found on the board
+    //      search_us   microseconds spent searching
+    //      Applies to the score, solve, solve-dups, analyze, and create
+    //      commands.  The counters can be left out of the build by
+    //      defining WGS_NO_STATS.  The create command also writes:
+    //      iterations          candidate boards scored
+    //      iterations_per_sec  the rate they were scored at
+    //
+    // --seed seed
+    //      Generate boards from the given seed rather than a random one, so
+    //      that create gives the same boards each time it is run with the
+    //      same arguments and configuration.  For serve, each client
+    //      connection has its own sequence taken from the seed, in the
+    //      order the clients connect.
+    //
+    // --ordered
+    //      When create is run with -j and a minimum number of words or
+    //      points, write the boards in the order they were started instead
+    //      of as each one is finished.  The output is then the same as
+    //      without -j for the same seed.
+    //
+    // --tempering replicas[,min-temp,max-temp[,steps[,patience]]]
+    //      Make the boards for create by parallel tempering instead of
+    //      annealing a single board.  The given number of replicas are
+    //      annealed at once, at temperatures spaced geometrically from
+    //      min-temp (default 1) to max-temp (default 30).  A temperature
+    //      is in words and points short of the target: a replica at 10
+    //      takes a candidate 10 further from the target than its board
+    //      about a third of the time.  Each round every replica scores
+    //      steps (default 10) candidates, then replicas at neighbouring
+    //      temperatures may swap boards.  A board is done once the target
+    //      is met or after patience (default 40) rounds without a better
+    //      board.  With -t, the replicas are stepped on the search threads.
+    //      The boards made do not depend on -j or -t.  Also applies to
+    //      create requests to serve.
+    //
+    // --trace
+    //      With --tempering, write a line to standard error for the best of
+    //      the starting boards and each time a better board is found: the
+    //      seconds since the board was started, the candidates scored so
+    //      far, and the words and points of the board.
+
+    CommandOptions opts;
+    int nargs = 1;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--stats") {
+            opts.stats = true;
+            continue;
+        }
+        if (arg == "--ordered") {
+            opts.ordered = true;
+            continue;
+        }
+        if (arg == "--trace") {
+            opts.tempering.trace = true;
+            continue;
+        }
+        if (arg == "--tempering") {
+            if (!parse_tempering(i + 1 < argc ? argv[i + 1] : NULL, opts.tempering)) {
+                cerr << "The --tempering option requires replicas[,min-temperature,max-temperature[,steps[,patience]]]" << endl;
+                return EXIT_FAILURE;
+            }
+            ++i;
+            continue;
+        }
+        if (arg == "--seed") {
+            char *end = NULL;
+            const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+            if (value) {
+                opts.seed = std::strtoull(value, &end, 10);
+            }
+            if (!end || end == value || *end != '\0') {
+                cerr << "The --seed option requires a number" << endl;
+                return EXIT_FAILURE;
+            }
+            ++i;
+            continue;
+        }
+        if (arg == "-j" || arg == "-t") {
+            size_t &count = (arg == "-j") ? opts.jobs : opts.search_threads;
+            if (!parse_thread_count(i + 1 < argc ? argv[i + 1] : NULL, count)) {
+                cerr << "The " << arg << " option requires a number of threads" << endl;
+                return EXIT_FAILURE;
+            }
+            ++i;
+            continue;
+        }
+        argv[nargs++] = argv[i];
+    }
+    argc = nargs;
 
     if (argc < 3) {
-        cerr << "Usage: " << argv[0] << " config-file command options" << endl;
+        cerr << "Usage: " << argv[0] << " [-j jobs] [-t threads] [--stats] [--seed seed] [--ordered] [--tempering schedule] [--trace] config-file command options" << endl;
         return EXIT_FAILURE;
     }
 
@@ -202,7 +467,7 @@ int main(int argc, char *argv[]) {
         }
         string game_rules = argv[3];
         GameRuleSet grs(config, game_rules);
-        do_score_boards(grs);
+        do_score_boards(grs, opts);
     }
     else if (command == "solve" || command=="solve-dups") {
         if (argc < 4 || argc > 7) {
@@ -228,7 +493,7 @@ int main(int argc, char *argv[]) {
             solution_suffix = argv[6];
         }
 
-        do_solve_boards(grs, fmt, command == "solve-dups", solution_prefix, solution_suffix);
+        do_solve_boards(grs, fmt, command == "solve-dups", solution_prefix, solution_suffix, opts);
     }
     else if (command == "analyze") {
         if (argc < 4 || argc > 6) {
@@ -246,7 +511,7 @@ int main(int argc, char *argv[]) {
         if (argc >= 6) {
             dump_words = (std::string(argv[5]) == "dump-words");
         }
-        do_analyze_boards(grs, fmt, dump_words);
+        do_analyze_boards(grs, fmt, dump_words, opts);
     }
     else if (command == "create") {
         if (argc < 4 || argc > 8) {
@@ -277,7 +542,7 @@ int main(int argc, char *argv[]) {
             reverse_target = true;
         }
 
-        do_generate_boards(grs, boards, min_words, min_score, reverse_target);
+        do_generate_boards(grs, boards, min_words, min_score, reverse_target, opts);
     }
     else if (command == "check-word") {
         if (argc != 4 && argc != 5) {
@@ -324,6 +589,50 @@ int main(int argc, char *argv[]) {
         GameRuleSet grs(config, game_rules);
         do_check_boards(grs, verbosity);
     }
+    else if (command == "serve") {
+        if (argc != 4) {
+            cerr << "Usage: " << argv[0] << " [-j jobs] [-t threads] config-file serve {socket-path}" << endl;
+            return EXIT_FAILURE;
+        }
+        if (opts.jobs == 0) {
+            opts.jobs = ThreadPool::hardware_threads();
+        }
+        Server server(config, opts);
+        return server.run(argv[3]);
+    }
+    else if (command == "compile-dict") {
+        if (argc != 5) {
+            cerr << "Usage: " << argv[0] << " config-file compile-dict {dictionary} {output-file}" << endl;
+            return EXIT_FAILURE;
+        }
+        string dict_name = argv[3];
+        if (config.dicts.find(dict_name) == config.dicts.end()) {
+            cerr << "'" << dict_name << "' is not a valid dictionary" << endl;
+            return EXIT_FAILURE;
+        }
+        return do_compile_dict(config.dicts[dict_name], argv[4]);
+    }
+    else if (command == "dict-stats") {
+        if (argc != 3) {
+            cerr << "Usage: " << argv[0] << " config-file dict-stats" << endl;
+            return EXIT_FAILURE;
+        }
+        return do_dict_stats(config);
+    }
+    else if (command == "bench") {
+        BenchOptions bench_opts;
+        bench_opts.search_threads = opts.search_threads;
+        if (argc >= 4) {
+            bench_opts.boards = std::strtoul(argv[3], NULL, 10);
+        }
+        if (argc >= 5) {
+            bench_opts.seed = std::strtoul(argv[4], NULL, 10);
+        }
+        for (int i = 5; i < argc; ++i) {
+            bench_opts.games.push_back(argv[i]);
+        }
+        return run_benchmarks(config, bench_opts);
+    }
     else {
         cerr << "'" << command << "' is not a valid command" << endl;
         return EXIT_FAILURE;
@@ -333,88 +642,161 @@ int main(int argc, char *argv[]) {
 }
 
 
-void do_solve_boards(const GameRuleSet &grs, const std::string fmt, bool solve_dups, std::string solution_prefix, std::string solution_suffix) {
-    // Load dictionary file
-    const char *dict_filename = grs.dict->dictFileName().c_str();
-    std::ifstream dict_file(dict_filename);
+void process_boards(const Dictionary &dict, const CommandOptions &opts, const BoardHandler &handler) {
+    // Runs handler on each board read from standard input and writes the
+    // results to standard output in input order.  With more than one job
+    // the boards are read in batches and spread over a pool of workers,
+    // each with its own Solver sharing the read-only dictionary.
+    std::string line;
+
+    std::unique_ptr<ThreadPool> search_pool;
+    if (opts.search_threads > 1) {
+        search_pool.reset(new ThreadPool(opts.search_threads));
+    }
 
-    if (!dict_file) {
-        std::cerr << "Failed to open dictionary file '" << dict_filename << "'"
-            << std::endl;
+    if (opts.jobs <= 1) {
+        Solver s(dict);
+        s.set_thread_pool(search_pool.get());
+        while (getline(std::cin, line)) {
+            std::cout << handler(s, 0, line) << std::flush;
+        }
+        if (opts.stats) {
+            s.get_stats().print(std::cerr);
+        }
         return;
     }
 
-    std::string line;
-    Solver s;
-    while (dict_file >> line) {
-        s.add_word(line.c_str());
+    ThreadPool pool(opts.jobs);
+    std::vector<std::unique_ptr<Solver> > solvers;
+    for (size_t i = 0; i < pool.size(); ++i) {
+        solvers.push_back(std::unique_ptr<Solver>(new Solver(dict)));
+        solvers.back()->set_thread_pool(search_pool.get());
     }
-    dict_file.close();
 
-    solution_prefix = unescape_string(solution_prefix);
-    solution_suffix = unescape_string(solution_suffix);
+    const size_t batch_size = 64 * pool.size();
+    std::vector<std::string> lines;
+    std::vector<std::string> results;
+    bool more = true;
 
-    std::cout << "Enter letters (empty to quit): ";
-    
-    while (getline(std::cin, line)) {
-        Board b(line.c_str(), grs.grid);
-        s.solve(&b, *grs.scoring_rules);
+    while (more) {
+        lines.clear();
+        while (lines.size() < batch_size) {
+            if (!getline(std::cin, line)) {
+                more = false;
+                break;
+            }
+            lines.push_back(line);
+        }
 
-        Solver::SolutionList solutions = s.get_solutions();
-        sort(solutions.begin(), solutions.end());
-        if (!solve_dups) {
-            solutions.erase(unique(solutions.begin(), solutions.end(), equal_words), solutions.end());
+        results.assign(lines.size(), std::string());
+        for (size_t i = 0; i < lines.size(); ++i) {
+            pool.submit([&, i](size_t worker) {
+                results[i] = handler(*solvers[worker], worker, lines[i]);
+            });
         }
+        pool.wait();
 
-        // print the solutions found and the requested information
-        std::cout << solution_prefix;
-        for (Solver::SolutionList::const_iterator i = solutions.begin(); i != solutions.end(); i++) {
-            std::cout << i->format(fmt, i != solutions.end() - 1);
+        for (size_t i = 0; i < results.size(); ++i) {
+            std::cout << results[i];
         }
-        std::cout << solution_suffix;
+        std::cout << std::flush;
+    }
+
+    if (opts.stats) {
+        SearchStats stats;
+        for (size_t i = 0; i < solvers.size(); ++i) {
+            stats += solvers[i]->get_stats();
+        }
+        stats.print(std::cerr);
     }
 }
 
 
-void do_analyze_boards(const GameRuleSet &grs, const std::string fmt, bool dump_words) {
-    // Load dictionary file
-    const char *dict_filename = grs.dict->dictFileName().c_str();
-    std::ifstream dict_file(dict_filename);
+std::string solve_board(Solver &s, const GameRuleSet &grs, const std::string &line, const std::string &fmt, bool solve_dups, bool order_by_score, const std::string &solution_prefix, const std::string &solution_suffix) {
+    Board b(line.c_str(), grs.grid);
 
-    if (!dict_file) {
-        std::cerr << "Failed to open dictionary file '" << dict_filename << "'"
-            << std::endl;
-        return;
+    // Unless duplicates are wanted the solver keeps only the best path for
+    // each word, so all that is left is to order them
+    s.solve(&b, *grs.scoring_rules, !solve_dups);
+
+    Solver::SolutionList solutions = s.get_solutions();
+    if (order_by_score) {
+        sort(solutions.begin(), solutions.end(), cmp_solutions);
+    }
+    else {
+        sort(solutions.begin(), solutions.end());
     }
 
-    std::string line;
-    Solver s;
-    while (dict_file >> line) {
-        s.add_word(line.c_str());
+    // format the solutions found and the requested information
+    std::string result = solution_prefix;
+    for (Solver::SolutionList::const_iterator i = solutions.begin(); i != solutions.end(); i++) {
+        result += i->format(fmt, i != solutions.end() - 1);
+    }
+    result += solution_suffix;
+    return result;
+}
+
+
+void do_solve_boards(const GameRuleSet &grs, const std::string fmt, bool solve_dups, std::string solution_prefix, std::string solution_suffix, const CommandOptions &opts) {
+    Dictionary dict;
+    if (!load_dictionary(*grs.dict, dict)) {
+        return;
     }
-    dict_file.close();
+
+    solution_prefix = unescape_string(solution_prefix);
+    solution_suffix = unescape_string(solution_suffix);
+
+    // Solutions are listed alphabetically unless SolutionOrder is "Score"
+    bool order_by_score = grs.preferences->preference("SolutionOrder") == "Score";
 
     std::cout << "Enter letters (empty to quit): ";
 
-    std::map<std::string, int> word_counts;
+    process_boards(dict, opts, [&](Solver &s, size_t, const std::string &line) {
+        return solve_board(s, grs, line, fmt, solve_dups, order_by_score, solution_prefix, solution_suffix);
+    });
+}
 
-    while (getline(std::cin, line)) {
-        Board b(line.c_str(), grs.grid);
-        s.solve(&b, *grs.scoring_rules);
-        Solver::SolutionList solutions = s.get_solutions();
-        sort(solutions.begin(), solutions.end());
-        SolutionAnalysis sa(b, solutions);
-        std::cout << sa.format(fmt);
 
-        if (dump_words) {
-            solutions.erase(unique(solutions.begin(), solutions.end(), equal_words), solutions.end());
-            for(Solver::SolutionList::iterator i = solutions.begin(); i != solutions.end(); ++i) {
-                word_counts[i->get_word()]++;
-            }
+std::string analyze_board(Solver &s, const GameRuleSet &grs, const std::string &line, const std::string &fmt, std::map<std::string, int> *word_counts) {
+    Board b(line.c_str(), grs.grid);
+    s.solve(&b, *grs.scoring_rules);
+    Solver::SolutionList solutions = s.get_solutions();
+    sort(solutions.begin(), solutions.end());
+    SolutionAnalysis sa(b, solutions);
+
+    if (word_counts) {
+        solutions.erase(unique(solutions.begin(), solutions.end(), equal_words), solutions.end());
+        for(Solver::SolutionList::iterator i = solutions.begin(); i != solutions.end(); ++i) {
+            (*word_counts)[i->get_word()]++;
         }
     }
 
+    return sa.format(fmt);
+}
+
+
+void do_analyze_boards(const GameRuleSet &grs, const std::string fmt, bool dump_words, const CommandOptions &opts) {
+    Dictionary dict;
+    if (!load_dictionary(*grs.dict, dict)) {
+        return;
+    }
+
+    std::cout << "Enter letters (empty to quit): ";
+
+    // Each worker keeps its own counts, these are combined at the end
+    std::vector<std::map<std::string, int> > worker_counts(std::max<size_t>(opts.jobs, 1));
+
+    process_boards(dict, opts, [&](Solver &s, size_t worker, const std::string &line) {
+        return analyze_board(s, grs, line, fmt, dump_words ? &worker_counts[worker] : 0);
+    });
+
     if (dump_words) {
+        std::map<std::string, int> word_counts;
+        for (auto &counts : worker_counts) {
+            for (auto &i : counts) {
+                word_counts[i.first] += i.second;
+            }
+        }
         for (auto &i : word_counts) {
             std::cerr << i.first << " " << i.second << std::endl;
         }
@@ -422,41 +804,27 @@ void do_analyze_boards(const GameRuleSet &grs, const std::string fmt, bool dump_
 }
 
 
-void do_score_boards(const GameRuleSet &grs) {
-    // Load dictionary file
-    const char *dict_filename = grs.dict->dictFileName().c_str();
-    std::ifstream dict_file(dict_filename);
+std::string score_board(Solver &s, const GameRuleSet &grs, const std::string &line) {
+    Board b(line.c_str(), grs.grid);
+    Solver::Score score = s.score(&b, *grs.scoring_rules);
 
-    if (!dict_file) {
-        std::cerr << "Failed to open dictionary file '" << dict_filename << "'"
-            << std::endl;
-        return;
-    }
+    std::stringstream result;
+    result << score.words << " " << score.points << std::endl;
+    return result.str();
+}
 
-    std::string line;
-    Solver s;
-    while (dict_file >> line) {
-        s.add_word(line.c_str());
+
+void do_score_boards(const GameRuleSet &grs, const CommandOptions &opts) {
+    Dictionary dict;
+    if (!load_dictionary(*grs.dict, dict)) {
+        return;
     }
-    dict_file.close();
 
     std::cout << "Enter letters (empty to quit): ";
 
-    while (getline(std::cin, line)) {
-        Board b(line.c_str(), grs.grid);
-        s.solve(&b, *grs.scoring_rules);
-        Solver::SolutionList solutions = s.get_solutions();
-        sort(solutions.begin(), solutions.end());
-        solutions.erase(unique(solutions.begin(), solutions.end(), equal_words), solutions.end());
-
-        size_t words = solutions.size();
-        size_t points = 0;
-
-        for(Solver::SolutionList::iterator i = solutions.begin(); i != solutions.end(); ++i) {
-            points += i->get_score();
-        }
-        std::cout << words << " " << points << std::endl;
-    }
+    process_boards(dict, opts, [&](Solver &s, size_t, const std::string &line) {
+        return score_board(s, grs, line);
+    });
 }
 
 
@@ -492,17 +860,29 @@ void do_check_boards(const GameRuleSet &grs, int verbosity) {
 }
 
 
-void do_generate_simple_boards(const GameRuleSet &grs, size_t boards) {
+void do_generate_simple_boards(const GameRuleSet &grs, Random &rng, size_t boards) {
     for (size_t i = 0; i < boards; ++i) {
-        std::cout << generate_simple_board(grs) << std::endl;
+        std::cout << generate_simple_board(grs, rng) << std::endl;
     }
 }
 
 
-void do_generate_boards(const GameRuleSet &grs, size_t boards, size_t min_words, size_t min_score, bool reverse_target) {
+typedef std::chrono::steady_clock Clock;
+
+static void print_iterations(std::ostream &out, size_t iterations, Clock::time_point start) {
+    // The candidate boards scored by create and the rate they were scored
+    // at, in the same form as the solver counters
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    out << "iterations=" << iterations << std::endl;
+    out << "iterations_per_sec=" << (elapsed.count() > 0 ? iterations / elapsed.count() : 0) << std::endl;
+}
+
+
+void do_generate_boards(const GameRuleSet &grs, size_t boards, size_t min_words, size_t min_score, bool reverse_target, const CommandOptions &opts) {
+    Random rng(opts.seed);
     if (min_words == 0 && min_score == 0 && !reverse_target) {
         // Don't load a dictionary if we don't have too
-        return do_generate_simple_boards(grs, boards);
+        return do_generate_simple_boards(grs, rng, boards);
     }
 
     if (grs.letters->generationMethod() == "WordList") {
@@ -510,31 +890,133 @@ void do_generate_boards(const GameRuleSet &grs, size_t boards, size_t min_words,
         return;
     }
 
-    // Load dictionary file
-    const char *dict_filename = grs.dict->dictFileName().c_str();
-    std::ifstream dict_file(dict_filename);
+    Dictionary dict;
+    if (!load_dictionary(*grs.dict, dict)) {
+        return;
+    }
+
+    std::unique_ptr<ThreadPool> search_pool;
+    if (opts.search_threads > 1) {
+        search_pool.reset(new ThreadPool(opts.search_threads));
+    }
+
+    // Each board is annealed with its own stream from the seed, so the
+    // boards do not depend on how many are made at once
+    Clock::time_point start = Clock::now();
+    if (opts.jobs <= 1) {
+        Solver s(dict);
+        s.set_thread_pool(search_pool.get());
 
-    if (!dict_file) {
-        std::cerr << "Failed to open dictionary file '" << dict_filename << "'"
-            << std::endl;
+        size_t iterations = 0;
+        for (size_t i = 0; i < boards; ++i) {
+            Random board_rng(rng);
+            rng.jump();
+            size_t scored = 0;
+            std::cout << create_board(s, grs, board_rng, min_words, min_score, reverse_target, opts.tempering, &scored) << std::flush;
+            iterations += scored;
+        }
+
+        if (opts.stats) {
+            s.get_stats().print(std::cerr);
+            print_iterations(std::cerr, iterations, start);
+        }
         return;
     }
 
-    std::string line;
-    Solver s;
-    while (dict_file >> line) {
-        s.add_word(line.c_str());
+    ThreadPool pool(opts.jobs);
+    std::vector<std::unique_ptr<Solver> > solvers;
+    for (size_t i = 0; i < pool.size(); ++i) {
+        solvers.push_back(std::unique_ptr<Solver>(new Solver(dict)));
+        solvers.back()->set_thread_pool(search_pool.get());
     }
-    dict_file.close();
-    std::string fmt = "%B %W %S";
+
+    // Finished boards wait in results until those before them are written
+    // when the order is kept
+    std::mutex output_lock;
+    std::vector<std::string> results(opts.ordered ? boards : 0);
+    std::vector<bool> finished(opts.ordered ? boards : 0);
+    size_t next_output = 0;
+    size_t iterations = 0;
 
     for (size_t i = 0; i < boards; ++i) {
-        std::string board = generate_board(grs, s, min_words, min_score, reverse_target);
-        Board b(board, grs.grid);
-        s.solve(&b, *grs.scoring_rules);
-        Solver::SolutionList solutions = s.get_solutions();
-        sort(solutions.begin(), solutions.end());
-        SolutionAnalysis sa(b, solutions);
-        std::cout << sa.format(fmt) << std::endl;
+        pool.submit([&, i, rng](size_t worker) {
+            Random board_rng(rng);
+            size_t scored = 0;
+            std::string result = create_board(*solvers[worker], grs, board_rng, min_words, min_score, reverse_target, opts.tempering, &scored);
+
+            std::lock_guard<std::mutex> guard(output_lock);
+            iterations += scored;
+            if (!opts.ordered) {
+                std::cout << result << std::flush;
+                return;
+            }
+
+            results[i].swap(result);
+            finished[i] = true;
+            for (; next_output < boards && finished[next_output]; ++next_output) {
+                std::cout << results[next_output];
+                std::string().swap(results[next_output]);
+            }
+            std::cout << std::flush;
+        });
+        rng.jump();
+    }
+    pool.wait();
+
+    if (opts.stats) {
+        SearchStats stats;
+        for (size_t i = 0; i < solvers.size(); ++i) {
+            stats += solvers[i]->get_stats();
+        }
+        stats.print(std::cerr);
+        print_iterations(std::cerr, iterations, start);
     }
 } 
+
+
+std::string create_board(Solver &s, const GameRuleSet &grs, Random &rng, size_t min_words, size_t min_score, bool reverse_target, const TemperingSchedule &schedule, size_t *iterations) {
+    // The annealer has already scored the board it returns, which gives
+    // the same words and points as the %W and %S of analyze
+    Solver::Score score;
+    std::string board = generate_board(grs, s, rng, min_words, min_score, reverse_target, &score, iterations, &schedule);
+
+    std::stringstream result;
+    result << board << " " << score.words << " " << score.points << std::endl;
+    return result.str();
+}
+
+
+int do_compile_dict(const GameDictionary &gd, const std::string &output_file) {
+    Dictionary dict;
+    if (!load_dictionary(gd, dict)) {
+        return EXIT_FAILURE;
+    }
+
+    if (!dict.compile(output_file)) {
+        return EXIT_FAILURE;
+    }
+
+    std::cerr << "Compiled " << dict.word_count() << " words, "
+        << dict.node_count() << " nodes, " << dict.size_bytes()
+        << " bytes" << std::endl;
+    return EXIT_SUCCESS;
+}
+
+int do_dict_stats(const GameConfig &config) {
+    int result = EXIT_SUCCESS;
+    std::cout << "dictionary\tstructure\twords\tnodes\tbytes\tbuild bytes" << std::endl;
+
+    for (auto i = config.dicts.begin(); i != config.dicts.end(); ++i) {
+        Dictionary dict;
+        if (!load_dictionary(i->second, dict)) {
+            result = EXIT_FAILURE;
+            continue;
+        }
+
+        std::cout << i->first << "\t"
+            << (dict.is_mapped() ? "Compiled" : i->second.structure()) << "\t"
+            << dict.word_count() << "\t" << dict.node_count() << "\t"
+            << dict.size_bytes() << "\t" << dict.build_bytes() << std::endl;
+    }
+    return result;
+}
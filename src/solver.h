@@ -0,0 +1,54 @@
+// This file is part of WGS, a customizable Word Game Solver.
+//
+// Copyright 2014 Robert Gamble <rgamble99@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WGS_SOLVER_H
+#define WGS_SOLVER_H
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include "dictionary.h"
+#include "maker.h"
+#include "random.h"
+#include "scramble.h"
+#include "wgs.h"
+
+class CommandOptions {
+public:
+    size_t jobs;            // boards processed at once (-j), 0 if not given
+    size_t search_threads;  // threads searching each board (-t)
+    bool stats;             // print solver counters when done (--stats)
+    uint64_t seed;          // for generating boards (--seed), random if not given
+    bool ordered;           // write created boards in order (--ordered)
+    TemperingSchedule tempering;    // for created boards (--tempering, --trace)
+
+    CommandOptions() : jobs(0), search_threads(1), stats(false),
+        seed(std::random_device()()), ordered(false) {}
+};
+
+bool load_dictionary(const GameDictionary &gd, Dictionary &dict);
+std::string unescape_string(const std::string &s);
+
+// The output of the solve, analyze, score and create commands for a single
+// board, shared by the command line and the server
+std::string solve_board(Solver &s, const GameRuleSet &grs, const std::string &line, const std::string &fmt, bool solve_dups, bool order_by_score, const std::string &solution_prefix, const std::string &solution_suffix);
+std::string analyze_board(Solver &s, const GameRuleSet &grs, const std::string &line, const std::string &fmt, std::map<std::string, int> *word_counts);
+std::string score_board(Solver &s, const GameRuleSet &grs, const std::string &line);
+std::string create_board(Solver &s, const GameRuleSet &grs, Random &rng, size_t min_words, size_t min_score, bool reverse_target, const TemperingSchedule &schedule, size_t *iterations = 0);
+
+#endif
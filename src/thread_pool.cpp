@@ -0,0 +1,117 @@
+// This file is part of WGS, a customizable Word Game Solver.
+//
+// Copyright 2014 Robert Gamble <rgamble99@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(size_t threads) :
+    next_queue(0), queued(0), pending(0), stopping(false) {
+    if (threads == 0) {
+        threads = 1;
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        queues.push_back(std::unique_ptr<TaskQueue>(new TaskQueue));
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        workers.push_back(std::thread(&ThreadPool::run, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        stopping = true;
+    }
+    task_ready.notify_all();
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+}
+
+void ThreadPool::submit(const Task &task) {
+    // Count the task before it becomes visible so that a worker finishing
+    // it can never take the counters below zero.
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        pending++;
+        queued++;
+    }
+
+    TaskQueue &q = *queues[next_queue++ % queues.size()];
+    {
+        std::unique_lock<std::mutex> guard(q.lock);
+        q.tasks.push_back(task);
+    }
+    task_ready.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (pending > 0) {
+        all_done.wait(guard);
+    }
+}
+
+size_t ThreadPool::hardware_threads() {
+    size_t n = std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+bool ThreadPool::take_task(size_t worker, Task &task) {
+    // Newest task from our own queue first, then the oldest task from
+    // each of the other queues.
+    for (size_t i = 0; i < queues.size(); ++i) {
+        TaskQueue &q = *queues[(worker + i) % queues.size()];
+        std::unique_lock<std::mutex> guard(q.lock);
+        if (q.tasks.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            task = q.tasks.back();
+            q.tasks.pop_back();
+        }
+        else {
+            task = q.tasks.front();
+            q.tasks.pop_front();
+        }
+        queued--;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::run(size_t worker) {
+    for (;;) {
+        Task task;
+        if (take_task(worker, task)) {
+            task(worker);
+
+            std::unique_lock<std::mutex> guard(lock);
+            if (--pending == 0) {
+                all_done.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(lock);
+        while (queued == 0 && !stopping) {
+            task_ready.wait(guard);
+        }
+        if (queued == 0 && stopping) {
+            return;
+        }
+    }
+}
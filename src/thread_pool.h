@@ -0,0 +1,76 @@
+// This file is part of WGS, a customizable Word Game Solver.
+//
+// Copyright 2014 Robert Gamble <rgamble99@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WGS_THREAD_POOL_H
+#define WGS_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+    // A fixed set of worker threads that run submitted tasks.  Each task
+    // is passed the index of the worker running it so that callers can
+    // keep per-worker scratch data (such as a Solver) without locking.
+    //
+    // Every worker has its own task queue.  Submitted tasks are dealt out
+    // to the queues in turn, workers take tasks from the back of their own
+    // queue and, when it runs dry, steal from the front of the others.
+public:
+    typedef std::function<void(size_t worker)> Task;
+
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    void submit(const Task &task);
+
+    // Block until every submitted task has finished
+    void wait();
+
+    size_t size() const { return workers.size(); }
+
+    // The number of threads to use when the user asks for "all cores"
+    static size_t hardware_threads();
+
+private:
+    struct TaskQueue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<TaskQueue> > queues;
+    std::atomic<size_t> next_queue;
+    std::atomic<size_t> queued;     // tasks waiting in any queue
+    std::mutex lock;
+    std::condition_variable task_ready;
+    std::condition_variable all_done;
+    size_t pending;                 // tasks submitted but not finished
+    bool stopping;
+
+    bool take_task(size_t worker, Task &task);
+    void run(size_t worker);
+    ThreadPool(const ThreadPool &);
+    ThreadPool& operator=(const ThreadPool &);
+};
+
+#endif
@@ -18,71 +18,118 @@
 #ifndef WGS_H
 #define WGS_H
 
+#include <algorithm>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #include <cctype>
 
-#define MAX_GRID_WIDTH 10
+// The largest number of rows or columns in a grid, which keeps the number
+// of tiles on a board within what a Solution can record
+#define MAX_GRID_WIDTH 255
+
+class GridAdjacency;
 
 class GameGrid {
     // Stores the positions that constitute a valid board for grid games.
+    // The tiles are kept as one bit per position, row after row, covering
+    // only the rows and columns that have been used.
 public:
-    GameGrid() : tile_adjacency(), tiles_set(0) {
-        clearTiles();
-    }
+    GameGrid() : tile_bits(), rows(0), columns(0), row_words(0),
+        tile_adjacency(), tiles_set(0), adjacency_cache() {}
 
     // Enable a tile for use on the grid
     void setTile(size_t x, size_t y, bool value) {
         if (x < MAX_GRID_WIDTH && y < MAX_GRID_WIDTH) {
-            if (grid_tiles[x][y]) {
+            if (!value || isTileSet(x, y)) {
                 return;
             }
-            grid_tiles[x][y] = value;
+            grow(x + 1, y + 1);
+            tile_bits[x * row_words + y / 64] |= uint64_t(1) << (y % 64);
             tiles_set++;
+            adjacency_cache.reset();
         }
     }
 
     // Disable all tiles
     void clearTiles() {
-        for(int i = 0; i < MAX_GRID_WIDTH; ++i) {
-            for (int j = 0; j < MAX_GRID_WIDTH; ++j) {
-                grid_tiles[i][j] = false;
-            }
-        }
+        tile_bits.clear();
+        rows = columns = row_words = 0;
         tiles_set = 0;
+        adjacency_cache.reset();
     }
 
     // Determine if a tile is used in the grid
     bool isTileSet(size_t x, size_t y) const {
-        if (x < MAX_GRID_WIDTH && y < MAX_GRID_WIDTH) {
-            return grid_tiles[x][y];
+        if (x < rows && y < columns) {
+            return (tile_bits[x * row_words + y / 64] >> (y % 64)) & 1;
         }
         return false;
     }
 
-    void setAdjacency(std::string d) { tile_adjacency = d; }
+    // The number of rows and columns up to the last tile set in each
+    size_t height() const { return rows; }
+    size_t width() const { return columns; }
+
+    void setAdjacency(std::string d) { tile_adjacency = d; adjacency_cache.reset(); }
     std::string adjacency() const { return tile_adjacency; }
     size_t tilesSet() const { return tiles_set; }
 
+    // The adjacency last built for boards on this grid, see GridAdjacency
+    // in scramble.h.  Safe to use from several threads at once.
+    std::shared_ptr<const GridAdjacency> cachedAdjacency() const {
+        return std::atomic_load(&adjacency_cache);
+    }
+    void setCachedAdjacency(std::shared_ptr<const GridAdjacency> a) const {
+        std::atomic_store(&adjacency_cache, a);
+    }
+
 private:
-    bool grid_tiles[MAX_GRID_WIDTH][MAX_GRID_WIDTH];
+    std::vector<uint64_t> tile_bits;
+    size_t rows;
+    size_t columns;
+    size_t row_words;       // words of tile_bits per row
     std::string tile_adjacency;
     size_t tiles_set;
+    mutable std::shared_ptr<const GridAdjacency> adjacency_cache;
+
+    void grow(size_t min_rows, size_t min_columns) {
+        size_t words = (std::max(columns, min_columns) + 63) / 64;
+        if (words > row_words) {
+            // Spread the existing rows out to the new row length
+            std::vector<uint64_t> bits(rows * words, 0);
+            for (size_t i = 0; i < rows; ++i) {
+                std::copy(tile_bits.begin() + i * row_words,
+                    tile_bits.begin() + (i + 1) * row_words,
+                    bits.begin() + i * words);
+            }
+            tile_bits.swap(bits);
+            row_words = words;
+        }
+        rows = std::max(rows, min_rows);
+        columns = std::max(columns, min_columns);
+        tile_bits.resize(rows * row_words, 0);
+    }
 };
 
 
 class GameDictionary {
-    // The name of a dictionary file
+    // The name of a dictionary file and the structure used to hold it in
+    // memory, either "Trie" or "DAWG".
 public:
-    GameDictionary() : dict_file() {}
-    GameDictionary(std::string dict_file_) : dict_file(dict_file_) {}
+    GameDictionary() : dict_file(), dict_structure("Trie") {}
+    GameDictionary(std::string dict_file_) : dict_file(dict_file_), dict_structure("Trie") {}
 
     std::string dictFileName() const { return dict_file; }
     void setDictFileName(std::string name) { dict_file = name; }
+    std::string structure() const { return dict_structure; }
+    void setStructure(std::string value) { dict_structure = value; }
 
 private:
     std::string dict_file;
+    std::string dict_structure;
 };
 
 
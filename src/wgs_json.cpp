@@ -97,7 +97,7 @@ int json_read_grids(json_t *grid_root, std::map<std::string, GameGrid> &grids) {
                 int x, y;
                 rv = json_unpack_ex(pos, &error, 0, "[i, i]", &x, &y);
                 if (rv == 0) {
-                    if (x < 0 || x > 10 || y < 0 || y > 10) {
+                    if (x < 1 || x > MAX_GRID_WIDTH || y < 1 || y > MAX_GRID_WIDTH) {
                         std::cerr << "Error processing config file: While processing tile list for grid "
                             << grid_name << ": Position " << x << "," << y << " is out of range"
                             << " for tile #" << (i+1) << std::endl;
@@ -131,11 +131,41 @@ int json_read_dicts(json_t *dict_root, std::map<std::string, GameDictionary> &di
     json_t *dict_data;
 
     json_object_foreach(dict_root, dict_name, dict_data) {
-        if (!json_is_string(dict_data)) {
+        // A dictionary is either the name of the word list file or an
+        // object that also selects the in-memory structure.
+        if (json_is_string(dict_data)) {
+            GameDictionary d(json_string_value(dict_data));
+            dicts[dict_name] = d;
+            dicts_read++;
             continue;
         }
 
-        GameDictionary d(json_string_value(dict_data));
+        if (!json_is_object(dict_data)) {
+            continue;
+        }
+
+        const char *dict_file = "";
+        const char *dict_structure = "Trie";
+
+        json_error_t error;
+        int rv = json_unpack_ex(dict_data, &error, 0, "{s:s, s?s}",
+            "File", &dict_file, "Structure", &dict_structure);
+
+        if (rv != 0) {
+            std::cerr << "Error processing config file: While processing dictionary " << dict_name
+                << ": " << error.text << std::endl;
+            continue;
+        }
+
+        GameDictionary d(dict_file);
+        if (strcmp(dict_structure, "Trie") == 0 || strcmp(dict_structure, "DAWG") == 0) {
+            d.setStructure(dict_structure);
+        }
+        else {
+            std::cerr << "Error processing config file: While processing dictionary " << dict_name
+                << ": " << dict_structure << " is not a valid value for Structure option" << std::endl;
+        }
+
         dicts[dict_name] = d;
         dicts_read++;
     }
@@ -421,8 +451,8 @@ int json_write_config(GameConfig &config, const char *filename) {
         const GameGrid &g = i->second;
         
         json_t *positions = json_array();
-        for (int i = 0; i < MAX_GRID_WIDTH; ++i) {
-            for (int j = 0; j < MAX_GRID_WIDTH; ++j) {
+        for (size_t i = 0; i < g.height(); ++i) {
+            for (size_t j = 0; j < g.width(); ++j) {
                 if (g.isTileSet(i, j)) {
                     json_t *pos = json_array();
                     json_array_append_new(pos, json_integer(i + 1));
@@ -443,8 +473,16 @@ int json_write_config(GameConfig &config, const char *filename) {
         std::string dict_name = i->first;
         const GameDictionary &d = i->second;
 
-        json_t *filename = json_string(d.dictFileName().c_str());
-        json_object_set(dict_root, dict_name.c_str(), filename);
+        if (d.structure() == "Trie") {
+            json_t *filename = json_string(d.dictFileName().c_str());
+            json_object_set(dict_root, dict_name.c_str(), filename);
+        }
+        else {
+            json_t *dict = json_pack("{s:s, s:s}",
+                "File", d.dictFileName().c_str(),
+                "Structure", d.structure().c_str());
+            json_object_set(dict_root, dict_name.c_str(), dict);
+        }
     }
 
     // build the scoring rules